@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "thread_pool.hpp"
+
+// thread counts a scaling bench runs with, 1, 2, 4, ... and always the
+// number of hardware threads itself even when it is not a power of two
+static std::vector<uint32_t> bench_thread_counts()
+{
+    uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> counts;
+    for(uint32_t threads = 1; threads < max_threads; threads *= 2) counts.push_back(threads);
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// runs the same job once per thread count on a fresh pool and prints its rate
+// next to the single threaded one. run(pool, threads) returns how many units
+// it processed, the pool is started before the clock so only the job is timed
+template<typename F>
+static void bench_thread_scaling(const char* unit, F run)
+{
+    double single_rate = 0.0;
+    for(uint32_t threads : bench_thread_counts())
+    {
+        ThreadPool pool(threads);
+        auto start = std::chrono::steady_clock::now();
+        double units = run(pool, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double rate = units / seconds;
+        if(threads == 1) single_rate = rate;
+        printfi("threads %2u: %12.1f %s/s (%.2fx)\n", threads, rate, unit, rate / single_rate);
+    }
+}
@@ -0,0 +1,32 @@
+#include "build_order.hpp"
+#include "geometry_builder.hpp"
+#include "bench_util.hpp"
+
+// builds the same set of boxes with a growing number of threads and merges
+// them into one buffer pair, the way a large schematic would be prepared
+// usage: geometry-builder-bench [box count]
+int main(int argc, char** argv)
+{
+    uint32_t box_count = 250000;
+    if(argc > 1) box_count = static_cast<uint32_t>(std::stoul(argv[1]));
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    bench_thread_scaling("boxes", [&](ThreadPool& pool, uint32_t threads) {
+        GeometryBuilder builder(threads);
+        vertices.clear();
+        indices.clear();
+        builder.Build(pool, box_count, [](GeometryBuilder::Chunk& chunk, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++) {
+                float x = static_cast<float>(i % 1000) * 4.0f;
+                float y = static_cast<float>(i / 1000) * 4.0f;
+                chunk.AddBox(x, y, 3.0f, 3.0f, 0.5f);
+            }
+        });
+        builder.Merge(pool, vertices, indices);
+        return static_cast<double>(box_count);
+    });
+    printfi("%zu vertices %zu indices\n", vertices.size(), indices.size());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include "build_order.hpp"
+#include "render_manager.hpp"
+#include "image_output.hpp"
+#include <chrono>
+
+// renders the same page over and over headless, once with the blocking
+// DrawHeadless + SaveImage style readback and once through the readback ring,
+// and touches every pixel of each frame the way an encoder would.
+// meant to run on a software driver (lavapipe/swiftshader) from the build directory
+// usage: headless-bench [frames] [width] [height] [rgba|rgb|gray]
+static uint64_t consume(const uint8_t* pixels, uint32_t width, uint32_t height, VkDeviceSize row_pitch)
+{
+    uint64_t sum = 0;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint32_t* row = (const uint32_t*) (pixels + y * row_pitch);
+        for(uint32_t x = 0; x < width; x++) sum += row[x] & 0x00ffffff;
+    }
+    return sum;
+}
+
+// packed rows, every byte is a color channel
+static uint64_t consume_packed(const uint8_t* pixels, VkDeviceSize row_size, uint32_t height, VkDeviceSize row_pitch)
+{
+    uint64_t sum = 0;
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = pixels + y * row_pitch;
+        for(VkDeviceSize x = 0; x < row_size; x++) sum += row[x];
+    }
+    return sum;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 60;
+    uint32_t width = 2480;
+    uint32_t height = 3508;
+    if(argc > 1) frames = static_cast<uint32_t>(std::stoul(argv[1]));
+    if(argc > 2) width = static_cast<uint32_t>(std::stoul(argv[2]));
+    if(argc > 3) height = static_cast<uint32_t>(std::stoul(argv[3]));
+    ReadbackPacking packing = ReadbackPacking::None;
+    if(argc > 4 && std::string(argv[4]) == "rgb") packing = ReadbackPacking::RGB8;
+    if(argc > 4 && std::string(argv[4]) == "gray") packing = ReadbackPacking::Gray8;
+
+    // a page full of boxes
+    std::vector<QuadInstance> quads;
+    uint32_t color = QuadInstance::PackColor({1.0f, 0.0f, 1.0f});
+    for(float y = 8.0f; y + 20.0f < height; y += 24.0f)
+    {
+        for(float x = 8.0f; x + 20.0f < width; x += 24.0f)
+        {
+            quads.push_back({{x, y}, 16.0f, 2.0f, 0.0f, color});
+            quads.push_back({{x, y + 14.0f}, 16.0f, 2.0f, 0.0f, color});
+            quads.push_back({{x + 2.0f, y}, 16.0f, 2.0f, glm::radians(90.0f), color});
+            quads.push_back({{x + 16.0f, y}, 16.0f, 2.0f, glm::radians(90.0f), color});
+        }
+    }
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    std::unique_ptr<RenderManager> renderer(new RenderManager());
+    RenderSettings render_settings = {};
+    render_settings.app_name = "Headless Bench";
+    render_settings.headless = true;
+    render_settings.width = width;
+    render_settings.height = height;
+    render_settings.readback_packing = packing;
+    renderer->Init(render_settings);
+    renderer->Setup();
+    renderer->SetupHeadless();
+
+    uint64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        VulkanImageView* output_view = renderer->DrawHeadless(vertices, indices, quads);
+        const uint8_t* pixels = (const uint8_t*) output_view->GetImageMemories()[0].mapped;
+        VkSubresourceLayout layout = output_view->GetSubresourceLayout();
+        checksum += consume(pixels + layout.offset, width, height, layout.rowPitch);
+        delete output_view;
+    }
+    double blocking = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < frames; i++)
+    {
+        renderer->SubmitHeadless(vertices, indices, quads, [&checksum](const ReadbackImage& image) {
+            uint32_t pixel_size = GetPixelSize(image.format);
+            if(pixel_size == 4) {
+                checksum += consume(image.pixels, image.width, image.height, image.row_pitch);
+            } else {
+                checksum += consume_packed(image.pixels, image.width * pixel_size, image.height, image.row_pitch);
+            }
+        });
+    }
+    renderer->FinishHeadless();
+    double pipelined = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printfi("%ux%u, %u frames, %zu quads\n", width, height, frames, quads.size());
+    printfi("blocking:  %8.2f frames/s\n", frames / blocking);
+    printfi("pipelined: %8.2f frames/s (%.2fx, %u slots, %s readback)\n",
+        frames / pipelined, blocking / pipelined, render_settings.readback_slots,
+        packing == ReadbackPacking::RGB8 ? "rgb" : packing == ReadbackPacking::Gray8 ? "gray" : "rgba"
+    );
+    printfv("checksum %llu\n", (unsigned long long) checksum);
+
+    renderer->Close();
+    return EXIT_SUCCESS;
+}
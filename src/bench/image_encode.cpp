@@ -0,0 +1,181 @@
+#include "build_order.hpp"
+#include "image_encoder.hpp"
+#include <chrono>
+#include <fstream>
+
+// encodes synthetic document pages in every output format and reports the
+// throughput over the 3 byte per pixel image and the encoded size. with an output
+// directory the pages are also saved, once through an ofstream and once mapped.
+// usage: image-encode-bench [iterations] [threads] [output directory]
+struct PageSize {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+};
+
+// white page with lines of glyph sized marks, a rule and a shaded figure
+static std::vector<uint8_t> make_page(uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4, 255);
+    uint32_t seed = 12345;
+    auto next = [&seed] { seed = seed * 1664525u + 1013904223u; return seed >> 16; };
+    auto fill = [&](uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t r, uint8_t g, uint8_t b) {
+        for(uint32_t y = y0; y < std::min(y1, height); y++)
+        {
+            for(uint32_t x = x0; x < std::min(x1, width); x++)
+            {
+                uint8_t* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+                p[0] = r;
+                p[1] = g;
+                p[2] = b;
+            }
+        }
+    };
+
+    const uint32_t margin = width / 12;
+    const uint32_t line_height = std::max(8u, height / 110);
+    const uint32_t glyph_height = line_height * 2 / 3;
+    const uint32_t figure_top = height / 2;
+    const uint32_t figure_bottom = figure_top + height / 5;
+
+    for(uint32_t y = margin; y + line_height < height - margin; y += line_height)
+    {
+        if(y + line_height > figure_top && y < figure_bottom) continue;
+        uint32_t x = margin;
+        uint32_t line_end = width - margin - (next() % 4 == 0 ? next() % (width / 3) : 0);
+        while(x < line_end)
+        {
+            uint32_t word = 3 + next() % 8;
+            for(uint32_t i = 0; i < word && x < line_end; i++)
+            {
+                uint32_t glyph_width = glyph_height / 2 + next() % (glyph_height / 3 + 1);
+                fill(x, y + line_height - glyph_height, x + glyph_width - 1, y + line_height, 20, 20, 20);
+                x += glyph_width;
+            }
+            x += glyph_height / 2;
+        }
+    }
+
+    // a bar chart with a soft background
+    for(uint32_t y = figure_top; y < figure_bottom; y++)
+    {
+        uint8_t shade = static_cast<uint8_t>(230 + 25 * (y - figure_top) / (figure_bottom - figure_top));
+        fill(margin, y, width - margin, y + 1, shade, shade, 255);
+    }
+    uint32_t bar_width = (width - 2 * margin) / 16;
+    for(uint32_t i = 0; i < 12; i++)
+    {
+        uint32_t bar_height = (figure_bottom - figure_top) * (20 + next() % 70) / 100;
+        uint32_t x = margin + bar_width * (i + 2);
+        fill(x, figure_bottom - bar_height, x + bar_width * 2 / 3, figure_bottom, 40 + i * 15, 90, 200 - i * 10);
+    }
+    fill(margin, figure_bottom + line_height, width - margin, figure_bottom + line_height + 2, 0, 0, 0);
+    return pixels;
+}
+
+static void run(const char* name, ImageEncoder& encoder, const PixelView& page, const EncodeSettings& settings, uint32_t iterations, size_t ppm_size)
+{
+    std::vector<uint8_t> out;
+    encoder.Encode(page, settings, out); // warm up
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++) {
+        encoder.Encode(page, settings, out);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double megabytes = static_cast<double>(page.width) * page.height * 3 * iterations / (1024.0 * 1024.0);
+    printfi("  %-12s %9.1f MB/s %10zu bytes (%5.1f%% of PPM)\n",
+        name, megabytes / seconds, out.size(), 100.0 * out.size() / ppm_size
+    );
+}
+
+// encoded into a buffer and written out, the path SaveImage took before mapped files
+static bool save_buffered(ImageEncoder& encoder, const std::string& path, const PixelView& page, const EncodeSettings& settings, std::vector<uint8_t>& buffer)
+{
+    encoder.Encode(page, settings, buffer);
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    file.write((const char*) buffer.data(), buffer.size());
+    file.close();
+    return !file.fail();
+}
+
+static void run_save(const char* name, ImageEncoder& encoder, const PixelView& page, const EncodeSettings& settings, uint32_t iterations, const std::string& path)
+{
+    std::vector<uint8_t> buffer;
+    double megabytes = static_cast<double>(page.width) * page.height * 3 * iterations / (1024.0 * 1024.0);
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++) {
+        save_buffered(encoder, path, page, settings, buffer);
+    }
+    double buffered = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++) {
+        encoder.Save(path, page, settings);
+    }
+    double mapped = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printfi("  %-12s %9.1f MB/s buffered %9.1f MB/s mapped\n", name, megabytes / buffered, megabytes / mapped);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterations = 5;
+    uint32_t threads = 0;
+    if(argc > 1) iterations = static_cast<uint32_t>(std::stoul(argv[1]));
+    if(argc > 2) threads = static_cast<uint32_t>(std::stoul(argv[2]));
+    std::string output_dir = (argc > 3) ? argv[3] : "";
+
+    ImageEncoder encoder(threads);
+    printfi("%u encoder threads, %u iterations\n", encoder.GetThreadCount(), iterations);
+
+    const PageSize sizes[] = {
+        {"A4 150dpi", 1240, 1754},
+        {"A4 300dpi", 2480, 3508},
+        {"Letter 300dpi", 2550, 3300},
+    };
+    for(const PageSize& size : sizes)
+    {
+        std::vector<uint8_t> pixels = make_page(size.width, size.height);
+        PixelView page;
+        page.pixels = pixels.data();
+        page.width = size.width;
+        page.height = size.height;
+        page.row_pitch = static_cast<VkDeviceSize>(size.width) * 4;
+        page.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+        std::vector<uint8_t> ppm;
+        encoder.Encode(page, EncodeSettings(), ppm);
+
+        printfi("%s (%ux%u)\n", size.name, size.width, size.height);
+        EncodeSettings settings;
+        run("ppm", encoder, page, settings, iterations, ppm.size());
+        settings.format = ImageFormat::QOI;
+        run("qoi", encoder, page, settings, iterations, ppm.size());
+        settings.format = ImageFormat::PNG;
+        run("png", encoder, page, settings, iterations, ppm.size());
+        // one strip is the single threaded baseline
+        settings.png_strip_rows = size.height;
+        run("png 1 strip", encoder, page, settings, iterations, ppm.size());
+        settings.png_strip_rows = 0;
+        settings.png_level = 1;
+        run("png level 1", encoder, page, settings, iterations, ppm.size());
+
+        if(!output_dir.empty())
+        {
+            const ImageFormat formats[] = {ImageFormat::PPM, ImageFormat::QOI, ImageFormat::PNG};
+            const char* names[] = {"save ppm", "save qoi", "save png"};
+            for(uint32_t i = 0; i < 3; i++)
+            {
+                EncodeSettings save_settings;
+                save_settings.format = formats[i];
+                run_save(names[i], encoder, page, save_settings, iterations, output_dir + "/image-encode-bench.out");
+            }
+            remove((output_dir + "/image-encode-bench.out").c_str());
+        }
+    }
+
+    return 0;
+}
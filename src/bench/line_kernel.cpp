@@ -0,0 +1,87 @@
+#include "build_order.hpp"
+#include "line_kernel.hpp"
+#include <chrono>
+
+// expands the same set of lines with the old per corner glm path (translate,
+// rotate and a mat4 multiply per vertex) and with the batched kernels
+// usage: line-kernel-bench [line count]
+static void expand_glm(const LineParams& lines, Vertex* out, glm::vec3 color)
+{
+    for(size_t i = 0; i < lines.count; i++)
+    {
+        glm::vec4 v1 = {0.0f, 0.0f, 0.0f, 1.0f};
+        glm::vec4 v2 = {0.0f, lines.thickness[i], 0.0f, 1.0f};
+        glm::vec4 v3 = {lines.length[i], lines.thickness[i], 0.0f, 1.0f};
+        glm::vec4 v4 = {lines.length[i], 0.0f, 0.0f, 1.0f};
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(lines.x[i], lines.y[i], 0.0f));
+        model = glm::rotate(model, lines.angle[i], glm::vec3(0.0f, 0.0f, 1.0f));
+
+        out[i * 4 + 0] = {model * v1, color};
+        out[i * 4 + 1] = {model * v2, color};
+        out[i * 4 + 2] = {model * v3, color};
+        out[i * 4 + 3] = {model * v4, color};
+    }
+}
+
+template<typename F>
+static double run(const char* name, uint32_t iterations, const LineParams& lines, std::vector<Vertex>& out, F expand)
+{
+    glm::vec3 color = {1.0f, 0.0f, 1.0f};
+    expand(lines, out.data(), color); // warm up
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++) {
+        expand(lines, out.data(), color);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double rate = lines.count * static_cast<double>(iterations) / seconds;
+    printfi("%-8s %14.0f lines/s\n", name, rate);
+    return rate;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t line_count = 1000000;
+    if(argc > 1) line_count = static_cast<uint32_t>(std::stoul(argv[1]));
+    const uint32_t iterations = 10;
+
+    std::vector<float> x(line_count), y(line_count), length(line_count), thickness(line_count), angle(line_count);
+    for(uint32_t i = 0; i < line_count; i++)
+    {
+        x[i] = static_cast<float>(i % 1000) * 4.0f;
+        y[i] = static_cast<float>(i / 1000) * 4.0f;
+        length[i] = 3.0f + static_cast<float>(i % 7);
+        thickness[i] = 0.5f;
+        angle[i] = glm::radians(static_cast<float>(i % 360) - 180.0f);
+    }
+
+    LineParams lines;
+    lines.x = x.data();
+    lines.y = y.data();
+    lines.length = length.data();
+    lines.thickness = thickness.data();
+    lines.angle = angle.data();
+    lines.count = line_count;
+
+    // same layout the kernel would write into a mapped vertex buffer
+    std::vector<Vertex> reference(line_count * 4);
+    std::vector<Vertex> out(line_count * 4);
+
+    double glm_rate = run("glm", iterations, lines, reference, expand_glm);
+    double scalar_rate = run("scalar", iterations, lines, out, ExpandLinesScalar);
+    double simd_rate = run(GetLineKernelName(), iterations, lines, out, ExpandLines);
+
+    float max_error = 0.0f;
+    for(size_t i = 0; i < out.size(); i++) {
+        max_error = std::max(max_error, std::abs(out[i].pos.x - reference[i].pos.x));
+        max_error = std::max(max_error, std::abs(out[i].pos.y - reference[i].pos.y));
+    }
+
+    printfi("scalar %.2fx, %s %.2fx over glm, max position error %g\n",
+        scalar_rate / glm_rate, GetLineKernelName(), simd_rate / glm_rate, max_error
+    );
+
+    return EXIT_SUCCESS;
+}
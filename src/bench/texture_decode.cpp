@@ -0,0 +1,38 @@
+#include "build_order.hpp"
+#include "bench_util.hpp"
+
+// decodes the same set of files with a growing number of threads, the same way
+// VulkanImageView::LoadImagesFromFile feeds the staging ring
+// usage: texture-decode-bench <image> [image ...]
+int main(int argc, char** argv)
+{
+    if(argc < 2) {
+        printfe("usage: %s <image> [image ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // repeat small sets so every run takes long enough to time
+    std::vector<std::string> paths;
+    while(paths.size() < 256) {
+        for(int i = 1; i < argc; i++) paths.push_back(argv[i]);
+    }
+
+    bench_thread_scaling("images", [&paths](ThreadPool& pool, uint32_t) {
+        std::vector<std::future<bool>> results;
+        for(auto& path : paths) {
+            results.push_back(pool.Submit([path]() {
+                int w, h, c;
+                stbi_uc* pixels = stbi_load(path.c_str(), &w, &h, &c, STBI_rgb_alpha);
+                if(!pixels) return false;
+                stbi_image_free(pixels);
+                return true;
+            }));
+        }
+        bool decoded = true;
+        for(auto& result : results) decoded = result.get() && decoded;
+        if(!decoded) printff("Failed to decode image\n");
+        return static_cast<double>(paths.size());
+    });
+
+    return EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@ struct QueueFamilyIndices
     uint32_t graphics_index = UINT32_MAX;
     uint32_t compute_index = UINT32_MAX;
     uint32_t present_index = UINT32_MAX;
+    uint32_t transfer_index = UINT32_MAX; // falls back to graphics_index without a transfer only family
 };
 
 struct SwapChainSupportDetails {
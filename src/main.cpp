@@ -3,10 +3,9 @@
 #include "swapchain.hpp"
 #include <unistd.h>
 
-uint32_t id = 0; // shape id
-
 std::vector<Vertex> vertices;
-std::vector<uint16_t> indices;
+std::vector<uint32_t> indices;
+std::vector<QuadInstance> quads;
 
 // 72 pixel/inch which is 595x842
 // 96 p/i 794x1123 -- default
@@ -16,39 +15,17 @@ const uint32_t width = 1280;
 const uint32_t height = 720;
 const float wf = static_cast<float>(width);
 const float hf = static_cast<float>(height);
-const glm::mat4 projOrtho = glm::ortho(0.0f, wf, hf, 0.0f,-5.0f, 5.0f); // we can do this in the fragment shader instead
 
+// one instance per line, quad.vert expands it to the four corners
 void draw_line(float x, float y, float length, float size=2, float angle=0) 
 {
-    glm::vec4 v1 = {0.0f, 0.0f, 0.0f, 1.0f};
-    glm::vec4 v2 = {0.0f, size, 0.0f, 1.0f};
-    glm::vec4 v3 = {length, size, 0.0f, 1.0f};
-    glm::vec4 v4 = {length, 0.0f, 0.0f, 1.0f};
-
-
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f));
-    model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
-
-    const Vertex verts[4] = {
-        {projOrtho * model * v1, {1.0f, 0.0f, 1.0f}}, // hard coded colors for now
-        {projOrtho * model * v2, {0.0f, 1.0f, 0.0f}},
-        {projOrtho * model * v3, {0.0f, 0.0f, 1.0f}},
-        {projOrtho * model * v4, {0.0f, 1.0f, 0.0f}}
-    };
-
-    vertices.insert(vertices.end(), verts, verts+4);
-
-    uint16_t tr = static_cast<uint16_t>(id);
-    uint16_t br = static_cast<uint16_t>(id + 1);
-    uint16_t bl = static_cast<uint16_t>(id + 2);
-    uint16_t tl = static_cast<uint16_t>(id + 3);
-    const uint16_t pos[6] = {
-        tr, br, bl, bl, tl, tr
-    };
-
-    indices.insert(indices.end(), pos, pos+6);
-
-    id+=4;
+    QuadInstance quad;
+    quad.pos = {x, y};
+    quad.length = length;
+    quad.thickness = size;
+    quad.angle = glm::radians(angle);
+    quad.color = QuadInstance::PackColor({1.0f, 0.0f, 1.0f}); // hard coded colors for now
+    quads.push_back(quad);
 }
 
 void draw_box(float x, float y, float w, float h, float size=2) 
@@ -80,7 +57,11 @@ int main()
     renderer->Setup();
 
     {
-        renderer->Draw(vertices, indices);
+        renderer->Draw(vertices, indices, quads);
+        // everything is on the gpu now
+        std::vector<Vertex>().swap(vertices);
+        std::vector<uint32_t>().swap(indices);
+        std::vector<QuadInstance>().swap(quads);
 
         renderer->WinLoop();
 
@@ -90,7 +71,7 @@ int main()
     // for headless
 /*
     {
-        VulkanImageView* output_view = renderer->DrawHeadLess(vertices, indices);
+        VulkanImageView* output_view = renderer->DrawHeadless(vertices, indices, quads);
         renderer->Close();
         renderer->SaveImage("another.ppm", output_view);
         delete output_view;
@@ -15,6 +15,12 @@ void RenderManager::Init(RenderSettings settings)
     m_physical_device = VulkanPhysicalDevice::GetPhysicalDevice(m_instance, m_surface, !settings.headless);
     m_device = new VulkanDevice(m_instance, m_physical_device);
     m_render_settings = settings;
+
+    m_frames_in_flight = settings.frames_in_flight;
+    if(m_frames_in_flight == 0) {
+        printfw("frames_in_flight must be at least 1, using 1\n");
+        m_frames_in_flight = 1;
+    }
 }
 
 void RenderManager::Setup() 
@@ -34,13 +40,23 @@ void RenderManager::Setup()
     };
     m_depth_view->CreateImageView(flags);
 
+    if(m_render_settings.scene_capacity > 0) {
+        // headless jobs cull into one region per readback slot
+        uint32_t regions = std::max(m_frames_in_flight, m_render_settings.readback_slots);
+        m_scene = new VulkanScene(m_device, m_render_settings.scene_capacity, regions);
+    }
+
     // create "screen"
     if(m_render_settings.headless)
     {
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if(m_render_settings.readback_packing != ReadbackPacking::None) {
+            usage |= VK_IMAGE_USAGE_SAMPLED_BIT; // read by the pack pass
+        }
         m_screen_view = new VulkanImageView(m_device);
         m_screen_view->GenerateImage(
             m_render_settings.width, m_render_settings.height, m_render_settings.src_format, 
-            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+            usage
         );
         VkImageAspectFlags flags[] = {
             VK_IMAGE_ASPECT_COLOR_BIT
@@ -58,13 +74,16 @@ void RenderManager::Setup()
     }
     
     m_pipeline = new VulkanGraphicsPipline(
-        m_device, m_render_settings.width, m_render_settings.height
+        m_device, m_render_settings.width, m_render_settings.height,
+        m_render_settings.pipeline_cache_path
     );
 
     m_depth_format = depth_format;
 }
 
-void RenderManager::Draw(std::vector<Vertex> vertices, std::vector<uint16_t> indices)
+void RenderManager::Draw(
+        const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<QuadInstance>& quads
+    )
 {
     if(m_swapchain_views.size() <= 0) {
         printfw("Failed to find swapchain image view\n");
@@ -76,23 +95,59 @@ void RenderManager::Draw(std::vector<Vertex> vertices, std::vector<uint16_t> ind
         return;
     }
 
-    m_vertex_buffer = new VulkanVertexBuffer(
-        m_device, vertices, indices
-    );
+    if(indices.size() > 0) {
+        m_vertex_buffer = new VulkanVertexBuffer(
+            m_device, vertices.data(), vertices.size(), indices.data(), indices.size(),
+            m_render_settings.vertex_format
+        );
+    } else if(vertices.size() > 0) {
+        m_vertex_buffer = new VulkanVertexBuffer(
+            m_device, vertices.data(), vertices.size(), m_render_settings.vertex_format
+        );
+    }
+    if(quads.size() > 0) {
+        m_quad_batch = new VulkanQuadBatch(m_device, quads);
+    }
+    if(m_render_settings.dynamic_vertex_capacity > 0) {
+        m_dynamic_buffer = new VulkanDynamicBuffer(
+            m_device, m_frames_in_flight,
+            m_render_settings.dynamic_vertex_capacity, m_render_settings.dynamic_index_capacity,
+            m_render_settings.vertex_format
+        );
+    }
 
     m_command_count = m_swapchain_views.size();
     m_command = new VkCommandBuffer[m_command_count];
+    m_stale_commands.assign(m_command_count, false);
     {
-        m_pipeline->CreateShaderModule("./../src/shader/vert.spv", "./../src/shader/frag.spv");
+        loadShaders();
         m_pipeline->CreateRenderPass(m_swapchain->GetFormat(), m_depth_format, true);
         m_pipeline->CreateFrameBuffers(m_swapchain_views.size(), m_swapchain_views, &m_depth_view->GetImageViews()[0]);
         m_pipeline->CreatePipelineLayout(m_render_settings.width, m_render_settings.height);
-        m_pipeline->CreateCommandBuffers(m_command, m_command_count, m_vertex_buffer);
+        m_pipeline->CreateCommandBuffers(m_command, m_command_count, m_vertex_buffer, m_quad_batch);
     }
 
     createSyncObjects();
 }
 
+void RenderManager::SetFrameCallback(std::function<void(VulkanDynamicBuffer*)> callback)
+{
+    m_frame_callback = callback;
+}
+
+VulkanScene* RenderManager::GetScene() { return m_scene; }
+
+void RenderManager::SetView(float x, float y, float width, float height)
+{
+    if(m_pipeline != nullptr) {
+        m_pipeline->SetProjection(glm::ortho(x, x + width, y + height, y, -5.0f, 5.0f));
+    }
+    if(m_scene != nullptr) {
+        m_scene->SetView({x, y, x + width, y + height});
+    }
+    m_stale_commands.assign(m_stale_commands.size(), true);
+}
+
 void RenderManager::WinLoop() 
 {
     printfi("RUNNING WINDOW LOOP\n");
@@ -103,49 +158,77 @@ void RenderManager::WinLoop()
     }
 }
 
-VulkanImageView* RenderManager::DrawHeadless( std::vector<Vertex> vertices, std::vector<uint16_t> indices) 
+// builds everything a headless job needs once, so DrawHeadless() only has to
+// upload, draw and read back
+void RenderManager::SetupHeadless() 
 {
+    if(m_headless_ready) return;
+
     if(m_screen_view == nullptr) {
         printfw("Failed to find screen image view\n");
-        return nullptr;
+        return;
     }
 
     if(m_pipeline == nullptr) {
         printfw("Failed to find pipeline. Must create pipeline layout first before draw\n");
-        return nullptr;
+        return;
     }
 
-    // vertex buffer setup
-    std::unique_ptr<VulkanVertexBuffer> vertex_buffer(new VulkanVertexBuffer(
-        m_device, vertices, indices
-    ));
-
-    uint32_t command_count = 1;
-    VkCommandBuffer* command = new VkCommandBuffer[command_count];
-    
     // graphics pipeline
     {
-        // Create Pipeline
-        m_pipeline->CreateShaderModule("./../src/shader/vert.spv", "./../src/shader/frag.spv");
+        loadShaders();
         m_pipeline->CreateRenderPass(m_render_settings.src_format, m_depth_format, false);
         m_pipeline->CreateFrameBuffers(1, m_screen_view->GetImageViews(), &m_depth_view->GetImageViews()[0]);
         m_pipeline->CreatePipelineLayout(m_render_settings.width, m_render_settings.height);
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = init::command_buffer_allocate_info(
+        m_device->GetGraphicsCommandPool(), 1
+    );
+    ErrorCheck(vkAllocateCommandBuffers(
+        m_device->GetDevice(), &alloc_info, &m_headless_command
+    ), "Allocate Headless Command Buffer");
 
-        // Start Drawing to buffer 
-        m_pipeline->CreateCommandBuffers(command, command_count, vertex_buffer.get());
-        
-        // since we are only dealing with one command buffer
-        m_device->SubmitWork(command[0], m_device->GetGraphicsQueue());
-        vkDeviceWaitIdle(m_device->GetDevice());
+    VkFenceCreateInfo fence_info = init::fence_info();
+    ErrorCheck(vkCreateFence(
+        m_device->GetDevice(), &fence_info, nullptr, &m_headless_fence
+    ), "Create Headless Fence");
+
+    if(m_render_settings.readback_packing != ReadbackPacking::None)
+    {
+        std::vector<char> code;
+        if(read_binary("./../src/shader/pack_comp.spv", code)) {
+            m_pack_pass = new VulkanPackPass(
+                m_device, code, m_screen_view->GetImageViews()[0],
+                m_render_settings.width, m_render_settings.height, m_render_settings.src_format,
+                m_render_settings.readback_packing, std::max(1u, m_render_settings.readback_slots)
+            );
+        } else {
+            printfw("Failed to load pack shader, reading back RGBA\n");
+        }
     }
 
-    m_device->FreeComputeCommand(command, command_count);
+    m_readback = new VulkanReadbackRing(
+        m_device, m_render_settings.width, m_render_settings.height,
+        m_render_settings.src_format, m_render_settings.readback_slots, m_pack_pass
+    );
+    m_headless_geometry.resize(m_readback->GetSlotCount());
 
-    return copyScreen(m_screen_view->GetImages()[0]);
+    m_headless_ready = true;
 }
 
-VulkanImageView* RenderManager::copyScreen(VkImage src_image) 
+VulkanImageView* RenderManager::DrawHeadless(
+        const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<QuadInstance>& quads
+    ) 
 {
+    SetupHeadless();
+    if(!m_headless_ready) return nullptr;
+
+    // pipelined jobs may still be reading the scene or the screen
+    m_readback->WaitIdle();
+
+    HeadlessGeometry geometry = createGeometry(vertices, indices, quads);
+
     // generate image
     VulkanImageView* output_view = new VulkanImageView(m_device);
     output_view->GenerateImage(
@@ -155,7 +238,104 @@ VulkanImageView* RenderManager::copyScreen(VkImage src_image)
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
     );
 
-    VkCommandBuffer copy_command = m_device->BeginSingleCommand();
+    // draw and copy in one submission, reusing the same command buffer every job
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    ErrorCheck(vkBeginCommandBuffer(
+        m_headless_command, &begin_info
+    ), "Begin Headless Command Buffer");
+
+    VulkanQuadBatch* scene_batch = nullptr;
+    if(m_scene != nullptr) {
+        m_scene->Update(0); // headless jobs wait for their fence, nothing reads the scene now
+        m_scene->Cull(0);
+        scene_batch = m_scene->GetQuadBatch(0);
+    }
+    m_pipeline->RecordRenderPass(
+        m_headless_command, 0, geometry.vertex_buffer.get(), geometry.quad_batch.get(), nullptr, scene_batch
+    );
+    copyScreen(m_headless_command, m_screen_view->GetImages()[0], output_view);
+
+    ErrorCheck(vkEndCommandBuffer(m_headless_command), "End Headless Command Buffer");
+
+    VkSubmitInfo submit_info = init::submit_info(1, &m_headless_command);
+    ErrorCheck(vkQueueSubmit(
+        m_device->GetGraphicsQueue(), 1, &submit_info, m_headless_fence
+    ), "Submit Headless Job");
+    ErrorCheck(vkWaitForFences(
+        m_device->GetDevice(), 1, &m_headless_fence, VK_TRUE, UINT64_MAX
+    ), "Wait For Headless Fence");
+    ErrorCheck(vkResetFences(
+        m_device->GetDevice(), 1, &m_headless_fence
+    ), "Reset Headless Fence");
+
+    return output_view;
+}
+
+uint64_t RenderManager::SubmitHeadless(
+        const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<QuadInstance>& quads,
+        ReadbackCallback callback
+    )
+{
+    SetupHeadless();
+    if(!m_headless_ready) return 0;
+
+    HeadlessGeometry geometry = createGeometry(vertices, indices, quads);
+
+    VkCommandBuffer command;
+    uint32_t slot = m_readback->Begin(&command);
+    m_headless_geometry[slot] = std::move(geometry); // the slot's previous job is complete
+
+    VulkanQuadBatch* scene_batch = nullptr;
+    if(m_scene != nullptr) {
+        // only this slot's instance buffer is touched, the other jobs keep drawing
+        m_scene->Update(slot);
+        m_scene->Cull(slot);
+        scene_batch = m_scene->GetQuadBatch(slot);
+    }
+    m_pipeline->RecordRenderPass(
+        command, 0, m_headless_geometry[slot].vertex_buffer.get(), m_headless_geometry[slot].quad_batch.get(),
+        nullptr, scene_batch
+    );
+    screenBarrier(command, m_screen_view->GetImages()[0]);
+    m_readback->RecordCopy(m_screen_view->GetImages()[0]);
+
+    return m_readback->Submit(callback);
+}
+
+void RenderManager::PollHeadless()
+{
+    if(m_readback != nullptr) m_readback->Poll();
+}
+
+void RenderManager::FinishHeadless()
+{
+    if(m_readback != nullptr) m_readback->WaitIdle();
+}
+
+RenderManager::HeadlessGeometry RenderManager::createGeometry(
+        const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<QuadInstance>& quads
+    )
+{
+    HeadlessGeometry geometry;
+    if(indices.size() > 0) {
+        geometry.vertex_buffer.reset(new VulkanVertexBuffer(
+            m_device, vertices.data(), vertices.size(), indices.data(), indices.size(),
+            m_render_settings.vertex_format
+        ));
+    } else if(vertices.size() > 0) {
+        geometry.vertex_buffer.reset(new VulkanVertexBuffer(
+            m_device, vertices.data(), vertices.size(), m_render_settings.vertex_format
+        ));
+    }
+    if(quads.size() > 0) {
+        geometry.quad_batch.reset(new VulkanQuadBatch(m_device, quads));
+    }
+    return geometry;
+}
+
+void RenderManager::copyScreen(VkCommandBuffer copy_command, VkImage src_image, VulkanImageView* output_view) 
+{
+    screenBarrier(copy_command, src_image);
 
     output_view->TransitionImageLayout(
         copy_command, output_view->GetImages()[0], 
@@ -176,14 +356,70 @@ VulkanImageView* RenderManager::copyScreen(VkImage src_image)
         copy_command, output_view->GetImages()[0],
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL
     );
+}
 
-    m_device->EndSingleCommand(copy_command, 1);
+// makes the color attachment writes visible to a transfer read
+void RenderManager::screenBarrier(VkCommandBuffer copy_command, VkImage src_image)
+{
+    // TODO: create image memory barrier in init.hpp
+    VkImageMemoryBarrier screen_barrier = {};
+    screen_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    screen_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    screen_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    screen_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    screen_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    screen_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    screen_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    screen_barrier.image = src_image;
+    screen_barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1
+    };
+    vkCmdPipelineBarrier(
+        copy_command,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 
+        0, nullptr, 
+        0, nullptr,
+        1, &screen_barrier
+    );
+}
 
-    return output_view;
+void RenderManager::loadShaders() 
+{
+    if(m_render_settings.vertex_format == VertexFormat::Packed) {
+        m_pipeline->CreateShaderModule("./../src/shader/packed_vert.spv", "./../src/shader/frag.spv");
+    } else {
+        m_pipeline->CreateShaderModule("./../src/shader/vert.spv", "./../src/shader/frag.spv");
+    }
+    m_pipeline->SetVertexFormat(m_render_settings.vertex_format);
+    m_pipeline->CreateQuadShaderModule("./../src/shader/quad_vert.spv", "./../src/shader/frag.spv");
+}
+
+void RenderManager::releaseHeadless() 
+{
+    if(!m_headless_ready) return;
+
+    // finishes the pending jobs before their geometry goes away
+    delete m_readback;
+    m_readback = nullptr;
+    delete m_pack_pass;
+    m_pack_pass = nullptr;
+    m_headless_geometry.clear();
+
+    vkFreeCommandBuffers(
+        m_device->GetDevice(), m_device->GetGraphicsCommandPool(), 
+        1, &m_headless_command
+    );
+    vkDestroyFence(m_device->GetDevice(), m_headless_fence, nullptr);
+    m_headless_command = VK_NULL_HANDLE;
+    m_headless_fence = VK_NULL_HANDLE;
+    m_headless_ready = false;
 }
 
 void RenderManager::Close() 
 {
+    releaseHeadless();
+
     // this is probably okay, right? we don't need that much performance... ?
     if(m_pipeline != nullptr) { 
         delete m_pipeline; // might not need to delete pipeline, but we need to remove frame buffer from pipeline first
@@ -207,62 +443,57 @@ void RenderManager::Wait()
 
 void RenderManager::SaveImage( std::string filename, VulkanImageView* output_view)
 {
+    // output images live in persistently mapped host visible memory
+    const uint8_t* imagedata = (const uint8_t*) output_view->GetImageMemories()[0].mapped;
+    if(imagedata == nullptr) {
+        printfe("Output image is not host visible\n");
+        return;
+    }
+    VkSubresourceLayout subresource_layout = output_view->GetSubresourceLayout();
 
-    const char* imagedata;
-    // TODO: place in imageview class? called CopyScreen?
-    VkImageSubresource image_subresource = {};
-    image_subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-
-    VkSubresourceLayout subresource_layout;
-    vkGetImageSubresourceLayout(
-        m_device->GetDevice(), output_view->GetImages()[0], &image_subresource, &subresource_layout
-    );
-    
-    vkMapMemory(
-        m_device->GetDevice(), output_view->GetImageMemories()[0],
-        0, VK_WHOLE_SIZE, 0, (void**)&imagedata
-    );
-    imagedata += subresource_layout.offset;
-
-    // TODO: separate this in to save_file()?
-    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
-    file << "P6\n" << m_render_settings.width << "\n" << m_render_settings.height << "\n" << 255 << "\n";
+    PixelView image;
+    image.pixels = imagedata + subresource_layout.offset;
+    image.width = m_render_settings.width;
+    image.height = m_render_settings.height;
+    image.row_pitch = subresource_layout.rowPitch;
+    image.format = m_render_settings.src_format;
 
-    std::vector<VkFormat> formats_BGR = {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM};
-    const bool color_swizzle = (std::find(formats_BGR.begin(), formats_BGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formats_BGR.end());
-    
     printfi("Saving Image as a file...\n");
-    for(int32_t y = 0; y < m_render_settings.height; y++) 
-    {
-        unsigned int *row = (unsigned int*) imagedata;
-        for(int32_t x = 0; x < m_render_settings.width; x++)
-        {
-            if(color_swizzle)
-            {
-                file.write((char*)row + 2, 1);
-                file.write((char*)row + 1, 1);
-                file.write((char*)row, 1);
-            } else {
-                file.write((char*)row, 3);
-            }
-            row++;
-        }
-        imagedata += subresource_layout.rowPitch;
+    if(GetImageEncoder()->Save(filename, image)) {
+        printfv("Framebuffer image is saved!\n");
+    }
+}
+
+ImageEncoder* RenderManager::GetImageEncoder()
+{
+    if(!m_image_encoder) {
+        m_image_encoder.reset(new ImageEncoder());
     }
-    file.close();
+    return m_image_encoder.get();
+}
 
-    printfv("Framebuffer image is saved!\n");
+FrameStats RenderManager::GetFrameStats() { return m_frame_stats; }
 
-    vkUnmapMemory(m_device->GetDevice(), output_view->GetImageMemories()[0]);
+void RenderManager::PrintMemoryStats() 
+{
+    if(m_device == nullptr) return;
+    m_device->GetAllocator()->PrintStats();
 }
 
 bool RenderManager::render()
 {
+    using clock = std::chrono::steady_clock;
+    auto frame_start = clock::now();
+    double wait_ms = 0.0;
+
+    // only blocks once the cpu is m_frames_in_flight frames ahead of the gpu
+    auto wait_start = clock::now();
     ErrorCheck(vkWaitForFences(
         m_device->GetDevice(), 1, 
         &m_in_flight_fences[m_current_frame], VK_TRUE, 
         UINT64_MAX
     ), "Wait For Fences");
+    wait_ms += std::chrono::duration<double, std::milli>(clock::now() - wait_start).count();
 
     uint32_t image_index;
     ErrorCheck(vkAcquireNextImageKHR(
@@ -271,19 +502,33 @@ bool RenderManager::render()
     ), "Acquire Next Image");
 
     if(m_image_in_flight[image_index] != VK_NULL_HANDLE) {
+        wait_start = clock::now();
         ErrorCheck(vkWaitForFences(
             m_device->GetDevice(), 1, 
             &m_image_in_flight[image_index], VK_TRUE, 
             UINT64_MAX
         ), "Wait For Fences");
+        wait_ms += std::chrono::duration<double, std::milli>(clock::now() - wait_start).count();
     }
     m_image_in_flight[image_index] = m_in_flight_fences[m_current_frame];
 
+    // the frame's own instance buffer is idle since its fence, the other frames
+    // in flight draw from theirs and catch up on the same edits on their turn
+    if(m_scene != nullptr) {
+        m_scene->Update(static_cast<uint32_t>(m_current_frame));
+    }
+
+    // both the frame's dynamic region and the image's command buffer are idle now
+    if(m_dynamic_buffer != nullptr || m_scene != nullptr || m_stale_commands[image_index]) {
+        recordFrame(image_index);
+    }
+
     VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSemaphore wait_semaphore[] = {m_image_available_semaphores[m_current_frame]};
     VkSemaphore signal_semaphore[] = {m_render_finished_semaphores[m_current_frame]};
     
-    VkSubmitInfo submit_info = init::submit_info(m_command_count, m_command);
+    // only the command buffer recorded against the acquired image's framebuffer
+    VkSubmitInfo submit_info = init::submit_info(1, &m_command[image_index]);
     submit_info.pWaitDstStageMask = wait_stages;
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = wait_semaphore;
@@ -298,8 +543,6 @@ bool RenderManager::render()
         m_device->GetGraphicsQueue(), 1, &submit_info, m_in_flight_fences[m_current_frame]
     ), "Sumbit Render Queue");
 
-    Wait();
-
     VkPresentInfoKHR present_info = {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.waitSemaphoreCount = 1;
@@ -312,23 +555,75 @@ bool RenderManager::render()
 
     ErrorCheck(vkQueuePresentKHR(m_device->GetPresentQueue(), &present_info), "Queue Present");
 
-    m_current_frame = (m_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_current_frame = (m_current_frame + 1) % m_frames_in_flight;
+
+    auto frame_end = clock::now();
+    double render_ms = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+    double frame_ms = render_ms;
+    if(m_frame_stats.frame > 0) {
+        frame_ms = std::chrono::duration<double, std::milli>(frame_end - m_last_frame).count();
+    }
+    m_last_frame = frame_end;
+
+    m_frame_stats.frame++;
+    m_frame_stats.presents++;
+    // counted from what was actually submitted, so a second command buffer shows up
+    for(uint32_t i = 0; i < submit_info.commandBufferCount; i++) {
+        m_frame_stats.draws += m_pipeline->GetRecordedDraws(submit_info.pCommandBuffers[i]);
+    }
+    m_frame_stats.draws_per_present = static_cast<double>(m_frame_stats.draws) / m_frame_stats.presents;
+    m_frame_stats.frame_ms = frame_ms;
+    m_frame_stats.wait_ms = wait_ms;
+    m_frame_stats.cpu_ms = render_ms - wait_ms;
+    m_frame_stats.overlap = (frame_ms > 0.0) ? std::max(0.0, 1.0 - wait_ms / frame_ms) : 0.0;
+
+    if(m_render_settings.frame_stats) {
+        printfv("frame %llu: %.3fms (cpu %.3fms, gpu wait %.3fms, overlap %.1f%%, draws/present %.2f)\n",
+            (unsigned long long) m_frame_stats.frame, m_frame_stats.frame_ms,
+            m_frame_stats.cpu_ms, m_frame_stats.wait_ms, m_frame_stats.overlap * 100.0,
+            m_frame_stats.draws_per_present
+        );
+    }
 
     return true;
 }
 
+void RenderManager::recordFrame(uint32_t image_index)
+{
+    m_stale_commands[image_index] = false;
+    if(m_dynamic_buffer != nullptr) {
+        m_dynamic_buffer->BeginFrame(static_cast<uint32_t>(m_current_frame));
+        if(m_frame_callback) m_frame_callback(m_dynamic_buffer);
+    }
+    if(m_scene != nullptr) {
+        m_scene->Cull(static_cast<uint32_t>(m_current_frame));
+    }
+
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    ErrorCheck(vkBeginCommandBuffer(
+        m_command[image_index], &begin_info
+    ), "Begin Frame Command Buffer");
+
+    m_pipeline->RecordRenderPass(
+        m_command[image_index], image_index, m_vertex_buffer, m_quad_batch, m_dynamic_buffer,
+        (m_scene != nullptr) ? m_scene->GetQuadBatch(static_cast<uint32_t>(m_current_frame)) : nullptr
+    );
+
+    ErrorCheck(vkEndCommandBuffer(m_command[image_index]), "End Frame Command Buffer");
+}
+
 void RenderManager::createSyncObjects() 
 {
-    m_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+    m_image_available_semaphores.resize(m_frames_in_flight);
+    m_render_finished_semaphores.resize(m_frames_in_flight);
+    m_in_flight_fences.resize(m_frames_in_flight);
     m_image_in_flight.resize(m_swapchain->GetImages().size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphore_info = {};
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     VkFenceCreateInfo fence_info = init::fence_info(VK_FENCE_CREATE_SIGNALED_BIT);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < m_frames_in_flight; i++)
     {
         ErrorCheck(vkCreateSemaphore(
             m_device->GetDevice(), &semaphore_info, 
@@ -349,7 +644,12 @@ void RenderManager::createSyncObjects()
 
 RenderManager::~RenderManager() 
 {
+    releaseHeadless();
+
     if(m_vertex_buffer != nullptr) delete m_vertex_buffer;
+    if(m_quad_batch != nullptr) delete m_quad_batch;
+    if(m_dynamic_buffer != nullptr) delete m_dynamic_buffer;
+    if(m_scene != nullptr) delete m_scene;
 
     if(m_command != nullptr) {
         m_device->FreeComputeCommand(m_command, m_command_count);
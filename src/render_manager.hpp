@@ -2,6 +2,7 @@
 
 #include "build_order.hpp"
 #include <functional>
+#include <chrono>
 #include "vulkan_config.hpp"
 #include "instance.hpp"
 #include "surface.hpp"
@@ -11,6 +12,12 @@
 #include "image_view.hpp"
 #include "pipeline.hpp"
 #include "vertex_buffer.hpp"
+#include "quad_batch.hpp"
+#include "dynamic_buffer.hpp"
+#include "scene.hpp"
+#include "readback_ring.hpp"
+#include "pack_pass.hpp"
+#include "image_encoder.hpp"
 
 struct RenderSettings {
     bool headless=false;
@@ -18,10 +25,29 @@ struct RenderSettings {
     uint32_t width=1280;
     uint32_t height=720;
     VkFormat src_format=VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t frames_in_flight=2; // how many frames the cpu may queue ahead of the gpu
+    bool frame_stats=false; // print FrameStats every frame
+    std::string pipeline_cache_path="pipeline.cache"; // empty to disable the on disk cache
+    VertexFormat vertex_format=VertexFormat::Standard; // Packed quantizes vertices to 8 bytes on upload
+    uint32_t dynamic_vertex_capacity=0; // per frame, 0 disables the dynamic buffer
+    uint32_t dynamic_index_capacity=0;
+    uint32_t scene_capacity=0; // quads in the retained scene, 0 disables it
+    uint32_t readback_slots=3; // headless jobs SubmitHeadless() keeps in flight
+    ReadbackPacking readback_packing=ReadbackPacking::None; // SubmitHeadless() pixel layout, packed on the compute queue
     std::string app_name;
     WindowSettings win_settings;
 };
 
+struct FrameStats {
+    uint64_t frame=0;
+    double frame_ms=0.0; // time between the last two presents
+    double cpu_ms=0.0;   // time spent acquiring, submitting and presenting
+    double wait_ms=0.0;  // time blocked on in flight fences (cpu stalled on gpu)
+    double overlap=0.0;  // fraction of the frame the cpu ran alongside the gpu
+    uint64_t presents=0;
+    uint64_t draws=0;    // draw calls submitted to the graphics queue
+    double draws_per_present=0.0; // should stay at the number of draws in a single scene
+};
 
 class RenderManager {
 public:
@@ -30,14 +56,39 @@ public:
 
     void Init(RenderSettings);
     void Setup();
-    void Draw(std::vector<Vertex>, std::vector<uint16_t>);
+    // vertices without indices are drawn as a quad list. geometry is uploaded
+    // before returning and not kept, the caller can free it right after
+    void Draw(const std::vector<Vertex>&, const std::vector<uint32_t>&, const std::vector<QuadInstance>& quads={});
     void WinLoop();
+    // called every frame before the command buffer is re-recorded, BeginFrame()
+    // has already been called on the dynamic buffer. needs the dynamic capacities set
+    void SetFrameCallback(std::function<void(VulkanDynamicBuffer*)>);
+    // retained shapes, edits are uploaded at the start of the next frame. null without scene_capacity
+    VulkanScene* GetScene();
+    // pans and zooms to the given rectangle in pixels after Draw(), the scene only draws what is inside it
+    void SetView(float x, float y, float width, float height);
 
-    VulkanImageView* DrawHeadless(std::vector<Vertex>, std::vector<uint16_t>);
+    void SetupHeadless();
+    VulkanImageView* DrawHeadless(
+        const std::vector<Vertex>&, const std::vector<uint32_t>&, const std::vector<QuadInstance>& quads={}
+    );
+    // pipelined DrawHeadless, draws and reads back in one submission without waiting.
+    // the callback gets the pixels from a later SubmitHeadless, PollHeadless or FinishHeadless
+    uint64_t SubmitHeadless(
+        const std::vector<Vertex>&, const std::vector<uint32_t>&, const std::vector<QuadInstance>&,
+        ReadbackCallback
+    );
+    void PollHeadless();
+    void FinishHeadless();
     void Close();
     void Wait();
 
+    // PNG and QOI by extension, otherwise PPM
     void SaveImage(std::string, VulkanImageView*);
+    // shared by SaveImage, for encoding the images handed to SubmitHeadless callbacks
+    ImageEncoder* GetImageEncoder();
+    FrameStats GetFrameStats();
+    void PrintMemoryStats();
 
 private:
     RenderSettings m_render_settings;
@@ -50,11 +101,17 @@ private:
     VulkanGraphicsPipline* m_pipeline=nullptr;
     VulkanSwapChain* m_swapchain=nullptr;
     VulkanVertexBuffer* m_vertex_buffer=nullptr;
+    VulkanQuadBatch* m_quad_batch=nullptr;
+    VulkanDynamicBuffer* m_dynamic_buffer=nullptr;
+    VulkanScene* m_scene=nullptr;
+    std::function<void(VulkanDynamicBuffer*)> m_frame_callback;
 
     std::vector<VkImageView> m_swapchain_views;
 
     size_t m_current_frame = 0;
-    const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+    uint32_t m_frames_in_flight = 2;
+    FrameStats m_frame_stats;
+    std::chrono::steady_clock::time_point m_last_frame;
     std::vector<VkSemaphore> m_image_available_semaphores;
     std::vector<VkSemaphore> m_render_finished_semaphores;
     std::vector<VkFence> m_in_flight_fences;
@@ -64,8 +121,31 @@ private:
 
     VkCommandBuffer* m_command=nullptr;
     uint32_t m_command_count;
+    std::vector<bool> m_stale_commands; // re-recorded before their next submit
+
+    // headless session, built once by SetupHeadless()
+    bool m_headless_ready=false;
+    VkCommandBuffer m_headless_command=VK_NULL_HANDLE;
+    VkFence m_headless_fence=VK_NULL_HANDLE;
+
+    // geometry of every readback slot, kept until the slot is reused
+    struct HeadlessGeometry {
+        std::unique_ptr<VulkanVertexBuffer> vertex_buffer;
+        std::unique_ptr<VulkanQuadBatch> quad_batch;
+    };
+    VulkanReadbackRing* m_readback=nullptr;
+    VulkanPackPass* m_pack_pass=nullptr; // only with readback_packing
+    std::vector<HeadlessGeometry> m_headless_geometry;
+    std::unique_ptr<ImageEncoder> m_image_encoder; // created on first use
 
     bool render();
     void createSyncObjects();
-    VulkanImageView* copyScreen(VkImage);
+    void recordFrame(uint32_t image_index);
+    void loadShaders();
+    void copyScreen(VkCommandBuffer, VkImage, VulkanImageView*);
+    void screenBarrier(VkCommandBuffer, VkImage);
+    HeadlessGeometry createGeometry(
+        const std::vector<Vertex>&, const std::vector<uint32_t>&, const std::vector<QuadInstance>&
+    );
+    void releaseHeadless();
 };
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "dynamic_buffer.hpp"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VulkanDynamicBuffer::VulkanDynamicBuffer(
+        VulkanDevice* device, uint32_t frame_count, uint32_t vertex_capacity, uint32_t index_capacity,
+        VertexFormat format
+    )
+{
+    m_device = device;
+    m_format = format;
+    m_stride = (m_format == VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
+    m_frame_count = std::max(1u, frame_count);
+    m_vertex_capacity = vertex_capacity;
+    m_index_capacity = index_capacity;
+
+    uint32_t max_index_value = m_device->GetPhysicalDevice()->GetProperties().limits.maxDrawIndexedIndexValue;
+    if(m_vertex_capacity > 0 && m_vertex_capacity - 1 > max_index_value) {
+        printfw("Dynamic buffer capacity %d is above maxDrawIndexedIndexValue\n", m_vertex_capacity);
+        m_vertex_capacity = max_index_value + 1;
+    }
+
+    // regions start on a boundary any usage is happy with
+    m_index_offset = align_up(m_vertex_capacity * m_stride, 256);
+    m_region_size = align_up(m_index_offset + m_index_capacity * sizeof(uint32_t), 256);
+
+    printfi("Creating Dynamic Buffer of %d x %.2f MiB...\n", m_frame_count, m_region_size / (1024.0 * 1024.0));
+    m_device->CreateBuffer(
+        m_region_size * m_frame_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &m_buffer, &m_memory
+    );
+    if(m_memory.mapped == nullptr) {
+        printff("Dynamic buffer memory is not mapped\n");
+    }
+}
+
+VulkanDynamicBuffer::~VulkanDynamicBuffer()
+{
+    printfi("-- Destroying Dynamic Buffer...\n");
+    m_device->DestroyBuffer(m_buffer, m_memory);
+}
+
+void VulkanDynamicBuffer::BeginFrame(uint32_t frame)
+{
+    m_frame = frame % m_frame_count;
+    m_vertex_count = 0;
+    m_index_count = 0;
+}
+
+uint32_t VulkanDynamicBuffer::Append(const Vertex* verts, uint32_t vert_count, const uint32_t* indices, uint32_t index_count)
+{
+    if(!reserve(vert_count, index_count)) return UINT32_MAX;
+
+    uint32_t base = m_vertex_count;
+    writeVertices(base, verts, vert_count);
+
+    uint32_t* dst = (uint32_t*) (getRegion() + m_index_offset) + m_index_count;
+    for(uint32_t i = 0; i < index_count; i++) dst[i] = base + indices[i];
+
+    m_vertex_count += vert_count;
+    m_index_count += index_count;
+    return base;
+}
+
+uint32_t VulkanDynamicBuffer::AppendLines(const LineParams& lines, glm::vec3 color)
+{
+    uint32_t line_count = static_cast<uint32_t>(lines.count);
+    if(!reserve(line_count * 4, line_count * 6)) return UINT32_MAX;
+
+    uint32_t base = m_vertex_count;
+    if(m_format == VertexFormat::Standard)
+    {
+        ExpandLines(lines, (Vertex*) getRegion() + base, color);
+    }
+    else
+    {
+        // packed vertices are expanded in small batches and quantized into place
+        Vertex scratch[256];
+        LineParams batch = lines;
+        for(uint32_t first = 0; first < line_count; first += 64)
+        {
+            batch.count = std::min(64u, line_count - first);
+            batch.x = lines.x + first;
+            batch.y = lines.y + first;
+            batch.length = lines.length + first;
+            batch.thickness = lines.thickness + first;
+            batch.angle = lines.angle + first;
+            ExpandLines(batch, scratch, color);
+            writeVertices(base + first * 4, scratch, static_cast<uint32_t>(batch.count * 4));
+        }
+    }
+
+    // tr, br, bl, bl, tl, tr
+    uint32_t* dst = (uint32_t*) (getRegion() + m_index_offset) + m_index_count;
+    for(uint32_t i = 0; i < line_count; i++)
+    {
+        uint32_t first = base + i * 4;
+        dst[0] = first;
+        dst[1] = first + 1;
+        dst[2] = first + 2;
+        dst[3] = first + 2;
+        dst[4] = first + 3;
+        dst[5] = first;
+        dst += 6;
+    }
+
+    m_vertex_count += line_count * 4;
+    m_index_count += line_count * 6;
+    return base;
+}
+
+void VulkanDynamicBuffer::Overwrite(uint32_t first_vertex, const Vertex* verts, uint32_t vert_count)
+{
+    if(first_vertex + vert_count > m_vertex_count) {
+        printfw("Overwrite of vertices %d..%d past the %d appended this frame\n",
+            first_vertex, first_vertex + vert_count, m_vertex_count
+        );
+        return;
+    }
+    writeVertices(first_vertex, verts, vert_count);
+}
+
+uint32_t VulkanDynamicBuffer::GetVertexCount() { return m_vertex_count; }
+uint32_t VulkanDynamicBuffer::GetIndexCount() { return m_index_count; }
+VertexFormat VulkanDynamicBuffer::GetFormat() { return m_format; }
+
+void VulkanDynamicBuffer::Record(VkCommandBuffer buffer)
+{
+    if(m_index_count == 0) return;
+
+    VkDeviceSize region = m_region_size * m_frame;
+    VkBuffer vertex_buffers[] = {m_buffer};
+    VkDeviceSize offsets[] = {region};
+    vkCmdBindVertexBuffers(buffer, 0, 1, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(buffer, m_buffer, region + m_index_offset, VK_INDEX_TYPE_UINT32);
+
+    vkCmdDrawIndexed(buffer, m_index_count, 1, 0, 0, 0);
+}
+
+uint8_t* VulkanDynamicBuffer::getRegion()
+{
+    return (uint8_t*) m_memory.mapped + m_region_size * m_frame;
+}
+
+bool VulkanDynamicBuffer::reserve(uint32_t vert_count, uint32_t index_count)
+{
+    if(m_vertex_count + vert_count > m_vertex_capacity || m_index_count + index_count > m_index_capacity)
+    {
+        printfw("Dynamic buffer is full, dropped %d vertices and %d indices\n", vert_count, index_count);
+        return false;
+    }
+    return true;
+}
+
+void VulkanDynamicBuffer::writeVertices(uint32_t first, const Vertex* verts, uint32_t count)
+{
+    uint8_t* dst = getRegion() + first * m_stride;
+    if(m_format == VertexFormat::Standard) {
+        memcpy(dst, verts, sizeof(Vertex) * count);
+        return;
+    }
+
+    PackedVertex* packed = (PackedVertex*) dst;
+    for(uint32_t i = 0; i < count; i++) packed[i] = PackedVertex::Pack(verts[i]);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "device.hpp"
+#include "memory_allocator.hpp"
+#include "vertex_buffer.hpp"
+#include "line_kernel.hpp"
+
+class VulkanDevice;
+
+// host visible vertex and index buffer for geometry that changes every frame.
+// one fixed size region per frame in flight, written through the persistent
+// mapping, so nothing is reallocated or staged. the frame's fence must have
+// signaled before BeginFrame() hands its region out again
+class VulkanDynamicBuffer
+{
+public:
+    VulkanDynamicBuffer(
+        VulkanDevice*, uint32_t frame_count, uint32_t vertex_capacity, uint32_t index_capacity,
+        VertexFormat format=VertexFormat::Standard
+    );
+    ~VulkanDynamicBuffer();
+
+    // selects the frame's region and empties it
+    void BeginFrame(uint32_t frame);
+    // indices are relative to the appended vertices, returns the first vertex
+    // or UINT32_MAX when the region is full and nothing was written
+    uint32_t Append(const Vertex*, uint32_t, const uint32_t*, uint32_t);
+    // expands the lines straight into the mapped region as quads
+    uint32_t AppendLines(const LineParams&, glm::vec3 color={1.0f, 0.0f, 1.0f});
+    // replaces vertices appended earlier in the same frame
+    void Overwrite(uint32_t first_vertex, const Vertex*, uint32_t);
+
+    uint32_t GetVertexCount();
+    uint32_t GetIndexCount();
+    VertexFormat GetFormat();
+    // the graphics pipeline matching GetFormat() must already be bound
+    void Record(VkCommandBuffer);
+
+private:
+    VulkanDevice* m_device;
+    VkBuffer m_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_memory;
+    VertexFormat m_format;
+    VkDeviceSize m_stride;
+
+    uint32_t m_frame_count;
+    uint32_t m_vertex_capacity;
+    uint32_t m_index_capacity;
+    VkDeviceSize m_index_offset;  // from the start of a region
+    VkDeviceSize m_region_size;
+
+    uint32_t m_frame=0;
+    uint32_t m_vertex_count=0;
+    uint32_t m_index_count=0;
+
+    uint8_t* getRegion();
+    bool reserve(uint32_t, uint32_t);
+    void writeVertices(uint32_t, const Vertex*, uint32_t);
+};
@@ -0,0 +1,119 @@
+#include "geometry_builder.hpp"
+
+void GeometryBuilder::Chunk::Add(const Vertex* verts, uint32_t vert_count, const uint32_t* shape_indices, uint32_t index_count)
+{
+    uint32_t base = static_cast<uint32_t>(vertices.size());
+    vertices.insert(vertices.end(), verts, verts + vert_count);
+    for(uint32_t i = 0; i < index_count; i++) {
+        indices.push_back(base + shape_indices[i]);
+    }
+}
+
+void GeometryBuilder::Chunk::AddQuad(const Vertex verts[4])
+{
+    // tr, br, bl, bl, tl, tr
+    static const uint32_t quad_indices[6] = {
+        0, 1, 2, 2, 3, 0
+    };
+    Add(verts, 4, quad_indices, 6);
+}
+
+void GeometryBuilder::Chunk::AddLine(float x, float y, float length, float size, float angle, glm::vec3 color)
+{
+    const float c = cosf(glm::radians(angle));
+    const float s = sinf(glm::radians(angle));
+    auto place = [&](float lx, float ly) {
+        return glm::vec4(x + lx * c - ly * s, y + lx * s + ly * c, 0.0f, 1.0f);
+    };
+
+    Vertex verts[4] = {};
+    verts[0].pos = place(0.0f, 0.0f);
+    verts[1].pos = place(0.0f, size);
+    verts[2].pos = place(length, size);
+    verts[3].pos = place(length, 0.0f);
+    for(auto& vert : verts) vert.color = color;
+
+    AddQuad(verts);
+}
+
+void GeometryBuilder::Chunk::AddBox(float x, float y, float w, float h, float size, glm::vec3 color)
+{
+    AddLine(x, y, w, size, 0, color);
+    AddLine(x+w-size, y, h, size, -90, color);
+    AddLine(x+w-size, y-h+size, w, size, 180, color);
+    AddLine(x, y-h+size, h, size, 90, color);
+}
+
+void GeometryBuilder::Chunk::AddLines(const LineParams& lines, glm::vec3 color)
+{
+    size_t base = vertices.size();
+    vertices.resize(base + lines.count * 4);
+    ExpandLines(lines, vertices.data() + base, color);
+
+    indices.reserve(indices.size() + lines.count * 6);
+    for(size_t i = 0; i < lines.count; i++)
+    {
+        uint32_t first = static_cast<uint32_t>(base + i * 4);
+        const uint32_t quad_indices[6] = {
+            first, first + 1, first + 2, first + 2, first + 3, first
+        };
+        indices.insert(indices.end(), quad_indices, quad_indices + 6);
+    }
+}
+
+void GeometryBuilder::Chunk::Clear()
+{
+    vertices.clear();
+    indices.clear();
+}
+
+GeometryBuilder::GeometryBuilder(uint32_t chunk_count)
+{
+    m_chunks.resize(std::max(1u, chunk_count));
+}
+
+uint32_t GeometryBuilder::GetChunkCount() { return static_cast<uint32_t>(m_chunks.size()); }
+GeometryBuilder::Chunk& GeometryBuilder::GetChunk(uint32_t index) { return m_chunks[index]; }
+
+void GeometryBuilder::Merge(ThreadPool& pool, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    // exclusive prefix sum over the chunk sizes
+    std::vector<size_t> vertex_offsets(m_chunks.size());
+    std::vector<size_t> index_offsets(m_chunks.size());
+    size_t vertex_count = 0;
+    size_t index_count = 0;
+    for(size_t i = 0; i < m_chunks.size(); i++)
+    {
+        vertex_offsets[i] = vertex_count;
+        index_offsets[i] = index_count;
+        vertex_count += m_chunks[i].vertices.size();
+        index_count += m_chunks[i].indices.size();
+    }
+    if(vertex_count > UINT32_MAX) {
+        printff("Merged geometry has more vertices than a 32 bit index can reach\n");
+    }
+
+    vertices.resize(vertex_count);
+    indices.resize(index_count);
+
+    std::vector<std::future<void>> jobs;
+    for(size_t i = 0; i < m_chunks.size(); i++)
+    {
+        jobs.push_back(pool.Submit([&, i]() {
+            const Chunk& chunk = m_chunks[i];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + vertex_offsets[i]);
+
+            uint32_t base = static_cast<uint32_t>(vertex_offsets[i]);
+            uint32_t* dst = indices.data() + index_offsets[i];
+            for(size_t j = 0; j < chunk.indices.size(); j++) {
+                dst[j] = chunk.indices[j] + base;
+            }
+        }));
+    }
+    for(auto& job : jobs) job.get();
+}
+
+void GeometryBuilder::Clear()
+{
+    for(auto& chunk : m_chunks) chunk.Clear();
+}
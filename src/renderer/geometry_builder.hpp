@@ -0,0 +1,56 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "vertex_buffer.hpp"
+#include "thread_pool.hpp"
+#include "line_kernel.hpp"
+
+// lets several threads emit shapes at once, each into its own chunk with
+// chunk local indices, Merge() then stitches the chunks into one buffer pair
+class GeometryBuilder
+{
+public:
+    struct Chunk {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices; // relative to this chunk's first vertex
+
+        // indices are relative to the shape's first vertex
+        void Add(const Vertex*, uint32_t, const uint32_t*, uint32_t);
+        void AddQuad(const Vertex[4]);
+        void AddLine(float x, float y, float length, float size=2, float angle=0, glm::vec3 color={1.0f, 0.0f, 1.0f});
+        void AddBox(float x, float y, float w, float h, float size=2, glm::vec3 color={1.0f, 0.0f, 1.0f});
+        // batched AddLine through the simd kernel, angles in radians
+        void AddLines(const LineParams&, glm::vec3 color={1.0f, 0.0f, 1.0f});
+        void Clear();
+    };
+
+    GeometryBuilder(uint32_t chunk_count);
+
+    uint32_t GetChunkCount();
+    Chunk& GetChunk(uint32_t);
+
+    // splits [0, shape_count) into one contiguous range per chunk and runs
+    // emit(chunk, begin, end) for each of them on the pool, shapes keep their order
+    template<typename F>
+    void Build(ThreadPool& pool, uint32_t shape_count, F emit)
+    {
+        uint32_t chunk_count = GetChunkCount();
+        std::vector<std::future<void>> jobs;
+        for(uint32_t i = 0; i < chunk_count; i++)
+        {
+            uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(shape_count) * i / chunk_count);
+            uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(shape_count) * (i + 1) / chunk_count);
+            Chunk* chunk = &m_chunks[i];
+            jobs.push_back(pool.Submit([chunk, begin, end, &emit]() { emit(*chunk, begin, end); }));
+        }
+        for(auto& job : jobs) job.get();
+    }
+
+    // prefix sums the chunk sizes, then every chunk copies itself into place
+    // and rebases its indices in parallel. chunks are left untouched
+    void Merge(ThreadPool&, std::vector<Vertex>&, std::vector<uint32_t>&);
+    void Clear();
+
+private:
+    std::vector<Chunk> m_chunks;
+};
@@ -0,0 +1,483 @@
+#include "image_encoder.hpp"
+#include "mapped_file.hpp"
+#include <zlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// rows handed to the filters have this many zero bytes in front, so the left
+// neighbours of the first pixel read as 0 without a special case
+static const size_t FILTER_PAD = 16;
+
+static uint8_t* put_u32_be(uint8_t* dst, uint32_t value)
+{
+    dst[0] = static_cast<uint8_t>(value >> 24);
+    dst[1] = static_cast<uint8_t>(value >> 16);
+    dst[2] = static_cast<uint8_t>(value >> 8);
+    dst[3] = static_cast<uint8_t>(value);
+    return dst + 4;
+}
+
+static uint8_t* put_png_chunk(uint8_t* dst, const char* type, const uint8_t* data, size_t size)
+{
+    dst = put_u32_be(dst, static_cast<uint32_t>(size));
+    uint8_t* start = dst;
+    dst = std::copy(type, type + 4, dst);
+    if(size > 0) dst = std::copy(data, data + size, dst);
+    return put_u32_be(dst, static_cast<uint32_t>(crc32(0, start, static_cast<uInt>(size + 4))));
+}
+
+static std::string ppm_header(uint32_t width, uint32_t height, uint32_t channels)
+{
+    std::string magic = (channels == 1) ? "P5\n" : "P6\n";
+    return magic + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if(pa <= pb && pa <= pc) return a;
+    if(pb <= pc) return b;
+    return c;
+}
+
+#if defined(__SSE2__)
+static inline __m128i abs_epi16(__m128i x)
+{
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// paeth predictor on 8 zero extended bytes
+static inline __m128i paeth_epi16(__m128i a, __m128i b, __m128i c)
+{
+    __m128i pa = abs_epi16(_mm_sub_epi16(b, c));
+    __m128i pb = abs_epi16(_mm_sub_epi16(a, c));
+    __m128i pc = abs_epi16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+    __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+    __m128i b_or_c = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+    return _mm_or_si128(_mm_and_si128(not_a, b_or_c), _mm_andnot_si128(not_a, a));
+}
+
+template<int type>
+static inline __m128i predict(__m128i a, __m128i b, __m128i c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    switch(type)
+    {
+        case 1: return a;
+        case 2: return b;
+        case 3: return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+        case 4: return _mm_packus_epi16(
+            paeth_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+            paeth_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero))
+        );
+        default: return zero;
+    }
+}
+#endif
+
+template<int type>
+static inline uint8_t predict(uint8_t a, uint8_t b, uint8_t c)
+{
+    switch(type)
+    {
+        case 1: return a;
+        case 2: return b;
+        case 3: return static_cast<uint8_t>((a + b) / 2);
+        case 4: return paeth(a, b, c);
+        default: return 0;
+    }
+}
+
+// applies the filter type to one padded row of bpp byte pixels and returns the sum
+// of the bytes as signed values, the usual heuristic for picking the row filter
+template<int type>
+static uint32_t filter_row(const uint8_t* row, const uint8_t* prev, uint8_t* out, size_t size, size_t bpp)
+{
+    uint32_t cost = 0;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*) (row + i - bpp));
+        __m128i b = _mm_loadu_si128((const __m128i*) (prev + i));
+        __m128i c = _mm_loadu_si128((const __m128i*) (prev + i - bpp));
+        __m128i x = _mm_loadu_si128((const __m128i*) (row + i));
+        __m128i value = _mm_sub_epi8(x, predict<type>(a, b, c));
+        _mm_storeu_si128((__m128i*) (out + i), value);
+        // |value| as a signed byte, summed 8 at a time
+        __m128i magnitude = _mm_min_epu8(value, _mm_sub_epi8(zero, value));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(magnitude, zero));
+    }
+    cost = static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#endif
+
+    for(; i < size; i++)
+    {
+        uint8_t value = row[i] - predict<type>(row[i - bpp], prev[i], prev[i - bpp]);
+        out[i] = value;
+        cost += std::abs(static_cast<int8_t>(value));
+    }
+    return cost;
+}
+
+static uint32_t filter_row(int type, const uint8_t* row, const uint8_t* prev, uint8_t* out, size_t size, size_t bpp)
+{
+    switch(type)
+    {
+        case 1: return filter_row<1>(row, prev, out, size, bpp);
+        case 2: return filter_row<2>(row, prev, out, size, bpp);
+        case 3: return filter_row<3>(row, prev, out, size, bpp);
+        case 4: return filter_row<4>(row, prev, out, size, bpp);
+        default: return filter_row<0>(row, prev, out, size, bpp);
+    }
+}
+
+ImageFormat ImageFormatFromPath(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos) return ImageFormat::PPM;
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == "png") return ImageFormat::PNG;
+    if(extension == "qoi") return ImageFormat::QOI;
+    return ImageFormat::PPM;
+}
+
+ImageEncoder::ImageEncoder(uint32_t thread_count) : m_pool(thread_count)
+{
+}
+
+size_t ImageEncoder::GetMaxEncodedSize(const PixelView& image, const EncodeSettings& settings)
+{
+    const size_t pixel_count = static_cast<size_t>(image.width) * image.height;
+    const uint32_t channels = GetOutputChannels(image.format);
+    switch(settings.format)
+    {
+        case ImageFormat::PNG:
+        {
+            // signature, IHDR, IEND and the zlib header and trailer
+            size_t size = 8 + 25 + 12 + 6;
+            uint32_t strip_rows = pngStripRows(image, settings);
+            for(uint32_t first_row = 0; first_row < image.height; first_row += strip_rows)
+            {
+                uint32_t rows = std::min(strip_rows, image.height - first_row);
+                // an IDAT per strip, and room for the sync flush
+                size += compressBound(static_cast<uLong>((image.width * channels + 1) * static_cast<size_t>(rows))) + 12 + 16;
+            }
+            return size;
+        }
+        // a 4 byte RGB op per pixel at worst
+        case ImageFormat::QOI: return 14 + pixel_count * 4 + 8;
+        default: return ppm_header(image.width, image.height, channels).size() + pixel_count * channels;
+    }
+}
+
+size_t ImageEncoder::Encode(const PixelView& image, const EncodeSettings& settings, uint8_t* dst)
+{
+    switch(settings.format)
+    {
+        case ImageFormat::PNG: return encodePng(image, settings, dst);
+        case ImageFormat::QOI: return encodeQoi(image, dst);
+        default: return encodePpm(image, dst);
+    }
+}
+
+void ImageEncoder::Encode(const PixelView& image, const EncodeSettings& settings, std::vector<uint8_t>& out)
+{
+    out.resize(GetMaxEncodedSize(image, settings));
+    out.resize(Encode(image, settings, out.data()));
+}
+
+bool ImageEncoder::Save(const std::string& path, const PixelView& image, const EncodeSettings& settings)
+{
+    // encoded straight from the pixels into the page cache of the file, the
+    // unused tail of the worst case size is cut off again by Close()
+    MappedFile file;
+    if(file.Create(path, GetMaxEncodedSize(image, settings))) {
+        size_t size = Encode(image, settings, file.GetData());
+        return file.Close(size);
+    }
+
+    // the worst case size could not be reserved, the buffered writers only
+    // need the disk space of the actual file
+    printfw("Writing %s without a mapping\n", path.c_str());
+    if(settings.format == ImageFormat::PPM) {
+        return WritePpm(path, image);
+    }
+    std::vector<uint8_t> encoded;
+    Encode(image, settings, encoded);
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::binary);
+    if(!out.is_open()) {
+        printfe("Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+    out.write((const char*) encoded.data(), encoded.size());
+    out.close();
+    if(out.fail()) {
+        printfe("Failed to write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ImageEncoder::Save(const std::string& path, const PixelView& image)
+{
+    EncodeSettings settings;
+    settings.format = ImageFormatFromPath(path);
+    return Save(path, image, settings);
+}
+
+uint32_t ImageEncoder::GetThreadCount() { return m_pool.GetThreadCount(); }
+
+size_t ImageEncoder::encodePpm(const PixelView& image, uint8_t* dst)
+{
+    const uint32_t channels = GetOutputChannels(image.format);
+    std::string header = ppm_header(image.width, image.height, channels);
+    uint8_t* rows = std::copy(header.begin(), header.end(), dst);
+
+    const size_t row_size = static_cast<size_t>(image.width) * channels;
+    for(uint32_t y = 0; y < image.height; y++) {
+        ConvertRow(image.pixels + y * image.row_pitch, rows + y * row_size, image.width, image.format);
+    }
+    return header.size() + row_size * image.height;
+}
+
+uint32_t ImageEncoder::pngStripRows(const PixelView& image, const EncodeSettings& settings)
+{
+    if(settings.png_strip_rows > 0) return settings.png_strip_rows;
+    uint32_t strips = GetThreadCount() * 4;
+    return std::max(16u, (image.height + strips - 1) / strips);
+}
+
+size_t ImageEncoder::encodePng(const PixelView& image, const EncodeSettings& settings, uint8_t* dst)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t* out = std::copy(signature, signature + 8, dst);
+
+    // 8 bit RGB or gray, no interlacing
+    uint8_t color_type = IsGrayFormat(image.format) ? 0 : 2;
+    uint8_t header[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, color_type, 0, 0, 0};
+    put_u32_be(put_u32_be(header, image.width), image.height);
+    out = put_png_chunk(out, "IHDR", header, sizeof(header));
+
+    // strips are raw deflate streams, every one but the last ends on a sync
+    // flush so they concatenate into a single zlib stream
+    uint32_t strip_rows = pngStripRows(image, settings);
+    uint32_t strip_count = std::max(1u, (image.height + strip_rows - 1) / strip_rows);
+
+    // the jobs write into strips, so every one has to finish before this
+    // frame can unwind, also when a job or a submission throws
+    std::vector<PngStrip> strips(strip_count);
+    std::vector<std::future<void>> jobs;
+    auto wait_all = [&jobs]() {
+        for(auto& job : jobs) job.wait();
+    };
+    try
+    {
+        jobs.reserve(strip_count);
+        for(uint32_t i = 0; i < strip_count; i++)
+        {
+            uint32_t first_row = i * strip_rows;
+            uint32_t rows = std::min(strip_rows, image.height - first_row);
+            bool last = (i + 1 == strip_count);
+            PngStrip* strip = &strips[i];
+            int level = settings.png_level;
+            jobs.push_back(m_pool.Submit([&image, first_row, rows, level, last, strip] {
+                deflateStrip(image, first_row, rows, level, last, strip);
+            }));
+        }
+    }
+    catch(...)
+    {
+        wait_all();
+        throw;
+    }
+    // get() below rethrows the first failed strip once nothing runs anymore
+    wait_all();
+
+    // zlib header for a 32K window, adler of all strips in the trailer
+    uint8_t zlib_header[2] = {0x78, 0x01};
+    uLong adler = adler32(0, nullptr, 0);
+    for(uint32_t i = 0; i < strip_count; i++)
+    {
+        jobs[i].get();
+        PngStrip& strip = strips[i];
+        adler = adler32_combine(adler, strip.adler, static_cast<z_off_t>(strip.raw_size));
+
+        if(i == 0) {
+            strip.data.insert(strip.data.begin(), zlib_header, zlib_header + 2);
+        }
+        if(i + 1 == strip_count) {
+            uint32_t checksum = static_cast<uint32_t>(adler);
+            strip.data.insert(strip.data.end(), {
+                static_cast<uint8_t>(checksum >> 24), static_cast<uint8_t>(checksum >> 16),
+                static_cast<uint8_t>(checksum >> 8), static_cast<uint8_t>(checksum)
+            });
+        }
+        out = put_png_chunk(out, "IDAT", strip.data.data(), strip.data.size());
+        std::vector<uint8_t>().swap(strip.data);
+    }
+
+    out = put_png_chunk(out, "IEND", nullptr, 0);
+    return out - dst;
+}
+
+void ImageEncoder::deflateStrip(const PixelView& image, uint32_t first_row, uint32_t rows, int level, bool last, PngStrip* strip)
+{
+    const size_t bpp = GetOutputChannels(image.format);
+    const size_t row_size = static_cast<size_t>(image.width) * bpp;
+
+    // the previous row is needed for the up, average and paeth filters
+    std::vector<uint8_t> rows_storage((FILTER_PAD + row_size) * 2, 0);
+    uint8_t* prev = rows_storage.data() + FILTER_PAD;
+    uint8_t* row = prev + row_size + FILTER_PAD;
+    if(first_row > 0) {
+        ConvertRow(image.pixels + (first_row - 1) * image.row_pitch, prev, image.width, image.format);
+    }
+
+    // the best filtered row so far and the one being tried
+    std::vector<uint8_t> candidates(row_size * 2);
+    uint8_t* best = candidates.data();
+    uint8_t* candidate = best + row_size;
+
+    std::vector<uint8_t> filtered((row_size + 1) * rows);
+    for(uint32_t y = 0; y < rows; y++)
+    {
+        ConvertRow(image.pixels + (first_row + y) * image.row_pitch, row, image.width, image.format);
+
+        uint8_t* dst = filtered.data() + y * (row_size + 1);
+        uint32_t best_cost = UINT32_MAX;
+        for(int type = 0; type < 5; type++)
+        {
+            uint32_t cost = filter_row(type, row, prev, candidate, row_size, bpp);
+            if(cost < best_cost) {
+                best_cost = cost;
+                dst[0] = static_cast<uint8_t>(type);
+                std::swap(best, candidate);
+            }
+        }
+        std::copy(best, best + row_size, dst + 1);
+        std::swap(prev, row);
+    }
+
+    strip->raw_size = filtered.size();
+    strip->adler = static_cast<uint32_t>(adler32(adler32(0, nullptr, 0), filtered.data(), static_cast<uInt>(filtered.size())));
+
+    z_stream stream = {};
+    if(deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        printff("Failed to initialize deflate\n");
+    }
+    // a sync flush adds an empty stored block on top of the bound
+    strip->data.resize(deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    stream.next_out = strip->data.data();
+    stream.avail_out = static_cast<uInt>(strip->data.size());
+    int res = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if(res != (last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0) {
+        printff("Failed to deflate PNG rows %u to %u\n", first_row, first_row + rows);
+    }
+    strip->data.resize(stream.total_out);
+    deflateEnd(&stream);
+}
+
+size_t ImageEncoder::encodeQoi(const PixelView& image, uint8_t* out)
+{
+    uint8_t* dst = out;
+
+    const uint8_t header[4] = {'q', 'o', 'i', 'f'};
+    dst = std::copy(header, header + 4, dst);
+    for(uint32_t value : {image.width, image.height})
+    {
+        *dst++ = static_cast<uint8_t>(value >> 24);
+        *dst++ = static_cast<uint8_t>(value >> 16);
+        *dst++ = static_cast<uint8_t>(value >> 8);
+        *dst++ = static_cast<uint8_t>(value);
+    }
+    *dst++ = 3; // RGB
+    *dst++ = 0; // sRGB with linear alpha
+
+    // gray pixels are read as r = g = b
+    const uint32_t stride = GetPixelSize(image.format);
+    const int r_index = IsGrayFormat(image.format) ? 0 : (IsBgrFormat(image.format) ? 2 : 0);
+    const int g_index = IsGrayFormat(image.format) ? 0 : 1;
+    const int b_index = IsGrayFormat(image.format) ? 0 : 2 - r_index;
+
+    // alpha is always 255, but unused index entries are zero and must not match black
+    uint8_t index[64][4] = {};
+    uint8_t pr = 0, pg = 0, pb = 0;
+    uint32_t run = 0;
+    for(uint32_t y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = image.pixels + y * image.row_pitch;
+        for(uint32_t x = 0; x < image.width; x++)
+        {
+            uint8_t r = row[x * stride + r_index];
+            uint8_t g = row[x * stride + g_index];
+            uint8_t b = row[x * stride + b_index];
+
+            if(r == pr && g == pg && b == pb) {
+                if(++run == 62) {
+                    *dst++ = 0xc0 | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if(run > 0) {
+                *dst++ = 0xc0 | (run - 1);
+                run = 0;
+            }
+
+            uint32_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+            if(index[hash][0] == r && index[hash][1] == g && index[hash][2] == b && index[hash][3] == 255) {
+                *dst++ = static_cast<uint8_t>(hash);
+            }
+            else
+            {
+                index[hash][0] = r;
+                index[hash][1] = g;
+                index[hash][2] = b;
+                index[hash][3] = 255;
+
+                int8_t dr = static_cast<int8_t>(r - pr);
+                int8_t dg = static_cast<int8_t>(g - pg);
+                int8_t db = static_cast<int8_t>(b - pb);
+                int8_t dr_dg = static_cast<int8_t>(dr - dg);
+                int8_t db_dg = static_cast<int8_t>(db - dg);
+
+                if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    *dst++ = 0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+                }
+                else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    *dst++ = 0x80 | (dg + 32);
+                    *dst++ = ((dr_dg + 8) << 4) | (db_dg + 8);
+                }
+                else {
+                    *dst++ = 0xfe;
+                    *dst++ = r;
+                    *dst++ = g;
+                    *dst++ = b;
+                }
+            }
+            pr = r;
+            pg = g;
+            pb = b;
+        }
+    }
+    if(run > 0) {
+        *dst++ = 0xc0 | (run - 1);
+    }
+
+    const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    dst = std::copy(end_marker, end_marker + 8, dst);
+    return dst - out;
+}
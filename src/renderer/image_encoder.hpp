@@ -0,0 +1,60 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "thread_pool.hpp"
+#include "image_output.hpp"
+
+enum class ImageFormat {
+    PPM, // raw P6, 3 bytes per pixel
+    PNG, // deflate, row strips are compressed in parallel
+    QOI  // single pass, much faster than PNG at a somewhat larger size
+};
+
+// .png and .qoi by extension, anything else is PPM
+ImageFormat ImageFormatFromPath(const std::string&);
+
+struct EncodeSettings {
+    ImageFormat format=ImageFormat::PPM;
+    int png_level=6;           // zlib level, 1 is about twice as fast but pages come out ~3x larger
+    uint32_t png_strip_rows=0; // rows deflated per job, 0 picks from the thread count
+};
+
+// encodes the 4 byte per pixel images of the output and readback paths to RGB
+// files, alpha is dropped. not thread safe, use one encoder per thread
+class ImageEncoder
+{
+public:
+    ImageEncoder(uint32_t thread_count=0);
+
+    // worst case size of the encoded file, exact for PPM
+    size_t GetMaxEncodedSize(const PixelView&, const EncodeSettings&);
+    // writes the whole file to dst, which must hold GetMaxEncodedSize() bytes.
+    // returns the bytes written
+    size_t Encode(const PixelView&, const EncodeSettings&, uint8_t* dst);
+    // replaces the contents of out with the whole encoded file
+    void Encode(const PixelView&, const EncodeSettings&, std::vector<uint8_t>& out);
+    // encodes into a memory mapped file, so pixels in mapped readback memory reach
+    // the file with the conversion or compression as the only CPU pass over them.
+    // falls back to a buffered write when the mapped file cannot be reserved
+    bool Save(const std::string& path, const PixelView&, const EncodeSettings&);
+    // format taken from the extension of path
+    bool Save(const std::string& path, const PixelView&);
+
+    uint32_t GetThreadCount();
+
+private:
+    // one independently deflated run of filtered rows
+    struct PngStrip {
+        std::vector<uint8_t> data;
+        uint32_t adler=1;
+        size_t raw_size=0;
+    };
+
+    ThreadPool m_pool;
+
+    size_t encodePpm(const PixelView&, uint8_t*);
+    size_t encodePng(const PixelView&, const EncodeSettings&, uint8_t*);
+    size_t encodeQoi(const PixelView&, uint8_t*);
+    uint32_t pngStripRows(const PixelView&, const EncodeSettings&);
+    static void deflateStrip(const PixelView&, uint32_t first_row, uint32_t rows, int level, bool last, PngStrip*);
+};
@@ -0,0 +1,154 @@
+#include "image_output.hpp"
+#include <fstream>
+
+// the SSSE3 rows are built with a target attribute and picked at runtime, the
+// default build only targets SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ROW_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// rows are converted into a block this big before each write
+static const size_t WRITE_BLOCK_SIZE = 4 * 1024 * 1024;
+
+bool IsBgrFormat(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SNORM:
+        case VK_FORMAT_B8G8R8A8_USCALED:
+        case VK_FORMAT_B8G8R8A8_SSCALED:
+        case VK_FORMAT_B8G8R8A8_UINT:
+        case VK_FORMAT_B8G8R8A8_SINT:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8_UNORM:
+        case VK_FORMAT_B8G8R8_SRGB:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool IsGrayFormat(VkFormat format)
+{
+    return format == VK_FORMAT_R8_UNORM || format == VK_FORMAT_R8_SRGB;
+}
+
+uint32_t GetPixelSize(VkFormat format)
+{
+    switch(format)
+    {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            return 1;
+        case VK_FORMAT_R8G8B8_UNORM:
+        case VK_FORMAT_R8G8B8_SRGB:
+        case VK_FORMAT_B8G8R8_UNORM:
+        case VK_FORMAT_B8G8R8_SRGB:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+uint32_t GetOutputChannels(VkFormat format) { return IsGrayFormat(format) ? 1 : 3; }
+
+#if defined(ROW_SSSE3)
+// converts all but the last few pixels and returns how many it did
+__attribute__((target("ssse3")))
+static uint32_t convert_row_ssse3(const uint8_t* src, uint8_t* dst, uint32_t width, bool swizzle)
+{
+    // 4 pixels in, 12 bytes out. every store writes 16 bytes, the 4 spare bytes
+    // are overwritten by the next store, so the stores stop 2 pixels short of the end
+    const __m128i rgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i bgr = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i shuffle = swizzle ? bgr : rgb;
+    uint32_t x = 0;
+    for(; x + 6 <= width; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*) (src + x * 4));
+        _mm_storeu_si128((__m128i*) (dst + x * 3), _mm_shuffle_epi8(pixels, shuffle));
+    }
+    return x;
+}
+
+static bool cpu_has_ssse3()
+{
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+#endif
+
+void ConvertRowToRgb(const uint8_t* src, uint8_t* dst, uint32_t width, bool swizzle)
+{
+    uint32_t x = 0;
+
+#if defined(ROW_SSSE3)
+    if(cpu_has_ssse3()) x = convert_row_ssse3(src, dst, width, swizzle);
+#endif
+
+    const int r = swizzle ? 2 : 0;
+    const int b = swizzle ? 0 : 2;
+    for(; x < width; x++)
+    {
+        dst[x * 3 + 0] = src[x * 4 + r];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + b];
+    }
+}
+
+void ConvertRow(const uint8_t* src, uint8_t* dst, uint32_t width, VkFormat format)
+{
+    const bool swizzle = IsBgrFormat(format);
+    switch(GetPixelSize(format))
+    {
+        case 4:
+            ConvertRowToRgb(src, dst, width, swizzle);
+            break;
+        case 3:
+            if(!swizzle) {
+                std::copy(src, src + static_cast<size_t>(width) * 3, dst);
+                break;
+            }
+            for(uint32_t x = 0; x < width; x++)
+            {
+                dst[x * 3 + 0] = src[x * 3 + 2];
+                dst[x * 3 + 1] = src[x * 3 + 1];
+                dst[x * 3 + 2] = src[x * 3 + 0];
+            }
+            break;
+        default:
+            std::copy(src, src + width, dst);
+            break;
+    }
+}
+
+bool WritePpm(const std::string& path, const PixelView& image)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    if(!file.is_open()) {
+        printfe("Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+    const uint32_t channels = GetOutputChannels(image.format);
+    file << (channels == 1 ? "P5\n" : "P6\n") << image.width << "\n" << image.height << "\n" << 255 << "\n";
+
+    const size_t row_size = static_cast<size_t>(image.width) * channels;
+    const uint32_t rows_per_block = static_cast<uint32_t>(std::max<size_t>(1, WRITE_BLOCK_SIZE / std::max<size_t>(1, row_size)));
+    std::vector<uint8_t> block(row_size * std::min(rows_per_block, image.height));
+
+    for(uint32_t y = 0; y < image.height; y += rows_per_block)
+    {
+        uint32_t rows = std::min(rows_per_block, image.height - y);
+        for(uint32_t i = 0; i < rows; i++)
+        {
+            const uint8_t* src = image.pixels + (y + i) * image.row_pitch;
+            ConvertRow(src, block.data() + i * row_size, image.width, image.format);
+        }
+        file.write((const char*) block.data(), rows * row_size);
+    }
+
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "readback_ring.hpp"
+
+// image in host memory, rows row_pitch bytes apart. 4 byte RGBA/BGRA pixels, or
+// the packed RGB8 and R8 (gray) pixels of a packing readback
+struct PixelView {
+    const uint8_t* pixels=nullptr;
+    uint32_t width=0;
+    uint32_t height=0;
+    VkDeviceSize row_pitch=0;
+    VkFormat format=VK_FORMAT_R8G8B8A8_UNORM;
+
+    static PixelView From(const ReadbackImage& image)
+    {
+        PixelView view;
+        view.pixels = image.pixels;
+        view.width = image.width;
+        view.height = image.height;
+        view.row_pitch = image.row_pitch;
+        view.format = image.format;
+        return view;
+    }
+};
+
+// true for the B8G8R8A8 and B8G8R8 formats, their red and blue swap on output
+bool IsBgrFormat(VkFormat);
+// true for the single channel R8 formats, written as grayscale
+bool IsGrayFormat(VkFormat);
+// bytes per pixel in host memory, 4 unless the format is 3 or 1 byte
+uint32_t GetPixelSize(VkFormat);
+// bytes per pixel in the written files, 1 for gray and 3 otherwise
+uint32_t GetOutputChannels(VkFormat);
+// drops alpha from one row, dst needs width * 3 bytes. uses SSSE3 shuffles when
+// the cpu supports them
+void ConvertRowToRgb(const uint8_t* src, uint8_t* dst, uint32_t width, bool swizzle);
+// one row of any supported format to width * GetOutputChannels() bytes of RGB or gray
+void ConvertRow(const uint8_t* src, uint8_t* dst, uint32_t width, VkFormat);
+// binary P6 (P5 for gray), converted a block of rows at a time and written with few large
+// writes. used by ImageEncoder::Save when the file cannot be mapped
+bool WritePpm(const std::string& path, const PixelView&);
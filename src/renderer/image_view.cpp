@@ -12,8 +12,8 @@ VulkanImageView::~VulkanImageView()
         vkDestroyImage(m_device->GetDevice(), img, nullptr);
     }
 
-    for(auto imgm : m_image_memories) {
-        vkFreeMemory(m_device->GetDevice(), imgm, nullptr);
+    for(auto& imgm : m_image_memories) {
+        m_device->GetAllocator()->Free(imgm);
     }
     
     for(auto iv : m_image_views) {
@@ -35,10 +35,22 @@ VulkanImageView::~VulkanImageView()
 }
 
 std::vector<VkImage> VulkanImageView::GetImages() { return m_images; }
-std::vector<VkDeviceMemory> VulkanImageView::GetImageMemories() { return m_image_memories; }
+std::vector<MemoryAllocation> VulkanImageView::GetImageMemories() { return m_image_memories; }
 std::vector<VkImageView> VulkanImageView::GetImageViews() { return m_image_views; }
 std::vector<VkSampler> VulkanImageView::GetSamplers() { return m_texture_samplers; }
 
+VkSubresourceLayout VulkanImageView::GetSubresourceLayout(uint32_t index)
+{
+    VkImageSubresource image_subresource = {};
+    image_subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    VkSubresourceLayout subresource_layout;
+    vkGetImageSubresourceLayout(
+        m_device->GetDevice(), m_images[index], &image_subresource, &subresource_layout
+    );
+    return subresource_layout;
+}
+
 // ? Could stream line this in function LoadImage()
 void VulkanImageView::CreateImageView(VkImageAspectFlags* flags)
 {
@@ -66,110 +78,97 @@ void VulkanImageView::LoadImage(uint32_t width, uint32_t height, uint8_t* pixels
 {
     printfi("Loading Image --> %dx%d\n", width, height);
 
-    VkDeviceSize image_size = width * height * 4;
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    m_device->CreateBuffer(
-        image_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging_buffer, &staging_buffer_memory
-    );
-
-    void* data;
-    vkMapMemory(m_device->GetDevice(), staging_buffer_memory, 0, image_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(image_size));
-    vkUnmapMemory(m_device->GetDevice(), staging_buffer_memory);
-
-    VkCommandBuffer command_buffer = m_device->BeginSingleCommand();
-    TransitionImageLayout(
-        command_buffer, m_images[0],
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-    );
-    m_device->EndSingleCommand(command_buffer);
-
-    copyBufferToImage(
-        staging_buffer, m_images[0], static_cast<uint32_t>(width), static_cast<uint32_t>(height)
-    );
-
-    command_buffer = m_device->BeginSingleCommand();
-    TransitionImageLayout(
-        command_buffer, m_images[0], 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    );
-    m_device->EndSingleCommand(command_buffer);
-
-    vkDestroyBuffer(m_device->GetDevice(), staging_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), staging_buffer_memory, nullptr);
-    
+    // the ring does the layout transitions around the copy
+    VulkanStagingRing* staging_ring = m_device->GetStagingRing();
+    staging_ring->UploadImage(m_images[0], width, height, pixels);
+    staging_ring->Flush();
 }
 
 void VulkanImageView::LoadImageFromFile(std::string path, VkFormat format)
 {
-    printfi("Loading Image From --> %s\n", path.c_str());
-    VkImage image;
-    VkDeviceMemory image_memory;
-    m_format.push_back(format);
+    LoadImagesFromFile({path}, format, 1);
+}
 
-    int tex_width, tex_height, tex_channels;
-    stbi_uc* pixels = stbi_load(path.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+// all images go out in one staging submission as long as their pixels fit in
+// the free space of the staging ring (32 MiB by default). larger batches still
+// share the one layout barrier, but the ring submits on the way and waits for
+// room whenever it fills. decoded pixels only live until they are copied into the ring.
+// threads=0 uses one decoder per core
+UploadTicket VulkanImageView::LoadImagesFromFile(const std::vector<std::string>& paths, VkFormat format, uint32_t threads)
+{
+    size_t first = m_images.size();
+    std::vector<VkImage> images;
 
-    VkDeviceSize image_size = tex_width * tex_height * 4;
+    for(auto& path : paths)
+    {
+        printfi("Loading Image From --> %s\n", path.c_str());
+        int tex_width, tex_height, tex_channels;
+        if(!stbi_info(path.c_str(), &tex_width, &tex_height, &tex_channels)) {
+            printff("Failed to Load Image --> %s\n", path.c_str());
+        }
 
-    if(!pixels) {
-        printff("Failed to Load Image --> %s\n", path.c_str());
+        VkImage image;
+        MemoryAllocation image_memory;
+        // color_format = VK_FORMAT_R8G8B8A8_SRGB
+        createImage(
+            static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height),
+            format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &image, &image_memory
+        );
+
+        images.push_back(image);
+        m_images.push_back(image);
+        m_image_memories.push_back(image_memory);
+        m_format.push_back(format);
     }
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    m_device->CreateBuffer(
-        image_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging_buffer, &staging_buffer_memory
-    );
+    VulkanStagingRing* staging_ring = m_device->GetStagingRing();
+    staging_ring->PrepareImages(images.data(), static_cast<uint32_t>(images.size()));
 
-    void* data;
-    vkMapMemory(m_device->GetDevice(), staging_buffer_memory, 0, image_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(image_size));
-    vkUnmapMemory(m_device->GetDevice(), staging_buffer_memory);
-
-    stbi_image_free(pixels);
-    // color_format = VK_FORMAT_R8G8B8A8_SRGB
-    createImage(
-        static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height),
-        format, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &image, &image_memory
-    );
+    // pixels are freed with the result, also when a failure unwinds past futures
+    // whose images were already decoded
+    struct DecodedImage {
+        std::unique_ptr<stbi_uc, void(*)(void*)> pixels{nullptr, stbi_image_free};
+        int width=0, height=0;
+    };
 
-    VkCommandBuffer command_buffer = m_device->BeginSingleCommand();
-    TransitionImageLayout(
-        command_buffer, image, 
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-    );
-    m_device->EndSingleCommand(command_buffer);
+    // workers decode ahead while this thread copies finished images into the
+    // ring in order, the window keeps decoded pixels from piling up
+    ThreadPool pool(threads);
+    const size_t window = 2 * pool.GetThreadCount();
+    std::deque<std::future<DecodedImage>> decoding;
+    size_t next = 0;
+    auto decode_ahead = [&]() {
+        while(next < paths.size() && decoding.size() < window) {
+            std::string path = paths[next++];
+            decoding.push_back(pool.Submit([path]() {
+                DecodedImage decoded;
+                int tex_channels;
+                decoded.pixels.reset(stbi_load(path.c_str(), &decoded.width, &decoded.height, &tex_channels, STBI_rgb_alpha));
+                return decoded;
+            }));
+        }
+    };
 
-    copyBufferToImage(
-        staging_buffer, image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height)
-    );
+    decode_ahead();
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        DecodedImage decoded = decoding.front().get();
+        decoding.pop_front();
+        decode_ahead();
 
-    command_buffer = m_device->BeginSingleCommand();
-    TransitionImageLayout(
-        command_buffer, image, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    );
-    m_device->EndSingleCommand(command_buffer);
+        if(!decoded.pixels) {
+            printff("Failed to Load Image --> %s\n", paths[i].c_str());
+        }
 
-    vkDestroyBuffer(m_device->GetDevice(), staging_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), staging_buffer_memory, nullptr);
+        staging_ring->CopyImage(
+            m_images[first + i], static_cast<uint32_t>(decoded.width), static_cast<uint32_t>(decoded.height), decoded.pixels.get()
+        );
+    }
 
-    m_images.push_back(image);
-    m_image_memories.push_back(image_memory);
+    return staging_ring->Flush();
 }
 
 void VulkanImageView::GenerateImage(
@@ -180,7 +179,7 @@ void VulkanImageView::GenerateImage(
 {
     printfi("Generating Image...\n");
     VkImage image;
-    VkDeviceMemory image_memory;
+    MemoryAllocation image_memory;
     createImage(
         width, height,
         format, tiling,
@@ -201,7 +200,7 @@ void VulkanImageView::GenerateTextureImage(
 {
     printfi("Generating Texture Image...\n");
     VkImage image;
-    VkDeviceMemory image_memory;
+    MemoryAllocation image_memory;
     createImage(
         width, height, format, 
         tiling, usage, properties,
@@ -229,7 +228,7 @@ void VulkanImageView::createImage(
         uint32_t width, uint32_t height, 
         VkFormat format, VkImageTiling tiling, 
         VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkImage* image, VkDeviceMemory* image_memory
+        VkImage* image, MemoryAllocation* image_memory
     )
 {
     VkImageCreateInfo image_info = init::image_info(width, height, format, tiling, usage);
@@ -244,23 +243,16 @@ void VulkanImageView::createImage(
     VkMemoryRequirements mem_requirements;
     vkGetImageMemoryRequirements(m_device->GetDevice(), *image, &mem_requirements);
 
-    VkMemoryAllocateInfo alloc_info = init::memory_allocate_info(
-        mem_requirements,
-        m_device->FindMemoryType(mem_requirements.memoryTypeBits, properties)
+    *image_memory = m_device->GetAllocator()->Allocate(
+        mem_requirements, properties,
+        AllocationStrategy::FreeList, tiling == VK_IMAGE_TILING_OPTIMAL
     );
 
-    ErrorCheck(vkAllocateMemory(
-        m_device->GetDevice(),
-        &alloc_info,
-        nullptr,
-        image_memory
-    ), "Allocate Memory");
-
     ErrorCheck(vkBindImageMemory(
         m_device->GetDevice(), 
         *image, 
-        *image_memory, 
-        0
+        image_memory->memory, 
+        image_memory->offset
     ), "Bind Image to Memory");
 }
 
@@ -345,30 +337,3 @@ void VulkanImageView::CreateTextureSampler()
 
     m_texture_samplers.push_back(texture_sampler);
 }
-
-void VulkanImageView::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) 
-{
-    VkCommandBuffer command_buffer = m_device->BeginSingleCommand();
-
-    // TODO: create buffer image copy in init.hpp
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource = {
-        VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1
-    };
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(
-        command_buffer, 
-        buffer, 
-        image, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
-
-    m_device->EndSingleCommand(command_buffer);
-}
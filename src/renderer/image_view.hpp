@@ -2,6 +2,8 @@
 
 #include "build_order.hpp"
 #include "device.hpp"
+#include "memory_allocator.hpp"
+#include "thread_pool.hpp"
 
 class VulkanImageView {
 
@@ -9,12 +11,15 @@ public:
     VulkanImageView(VulkanDevice*);
     ~VulkanImageView();
     std::vector<VkImage> GetImages();
-    std::vector<VkDeviceMemory> GetImageMemories();
+    std::vector<MemoryAllocation> GetImageMemories();
     std::vector<VkImageView> GetImageViews();
     std::vector<VkSampler> GetSamplers();
+    VkSubresourceLayout GetSubresourceLayout(uint32_t index=0); // linear images only
     void CreateImageView(VkImageAspectFlags*);
     void LoadImage(uint32_t, uint32_t, uint8_t*);
     void LoadImageFromFile(std::string, VkFormat);
+    // one staging submission while the batch fits in the free space of the staging ring
+    UploadTicket LoadImagesFromFile(const std::vector<std::string>&, VkFormat, uint32_t threads=0);
     void GenerateImage(
         uint32_t, uint32_t, 
         VkFormat, VkImageUsageFlags,
@@ -41,7 +46,7 @@ private:
     VulkanDevice* m_device;
     std::vector<VkImageView> m_image_views;
     std::vector<VkImage> m_images;
-    std::vector<VkDeviceMemory> m_image_memories;
+    std::vector<MemoryAllocation> m_image_memories;
     std::vector<VkFormat> m_format;
     std::vector<VkSampler> m_texture_samplers;
 
@@ -49,8 +54,6 @@ private:
         uint32_t, uint32_t, 
         VkFormat, VkImageTiling, 
         VkImageUsageFlags, VkMemoryPropertyFlags,
-        VkImage*, VkDeviceMemory*);
-
-    void copyBufferToImage(VkBuffer, VkImage, uint32_t, uint32_t);
+        VkImage*, MemoryAllocation*);
 
 };
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "line_kernel.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+static inline void write_corner(Vertex& vertex, float x, float y, const glm::vec3& color)
+{
+    vertex.pos = glm::vec4(x, y, 0.0f, 1.0f);
+    vertex.color = color;
+}
+
+static inline void expand_line(float x, float y, float length, float thickness, float c, float s, Vertex* out, const glm::vec3& color)
+{
+    write_corner(out[0], x, y, color);
+    write_corner(out[1], x - thickness * s, y + thickness * c, color);
+    write_corner(out[2], x + length * c - thickness * s, y + length * s + thickness * c, color);
+    write_corner(out[3], x + length * c, y + length * s, color);
+}
+
+void ExpandLinesScalar(const LineParams& lines, Vertex* out, glm::vec3 color)
+{
+    for(size_t i = 0; i < lines.count; i++)
+    {
+        expand_line(
+            lines.x[i], lines.y[i], lines.length[i], lines.thickness[i],
+            cosf(lines.angle[i]), sinf(lines.angle[i]), out + i * 4, color
+        );
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+
+// thin wrappers so sincos and the expansion are written once for both widths
+#if defined(__AVX2__)
+struct Lanes {
+    typedef __m256 F;
+    typedef __m256i I;
+    static const size_t width = 8;
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+    static F set(float v) { return _mm256_set1_ps(v); }
+    static I seti(int v) { return _mm256_set1_epi32(v); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F and_(F a, F b) { return _mm256_and_ps(a, b); }
+    static F andnot(F a, F b) { return _mm256_andnot_ps(a, b); }
+    static F or_(F a, F b) { return _mm256_or_ps(a, b); }
+    static F xor_(F a, F b) { return _mm256_xor_ps(a, b); }
+    static I to_int(F a) { return _mm256_cvttps_epi32(a); }
+    static F to_float(I a) { return _mm256_cvtepi32_ps(a); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static I andnoti(I a, I b) { return _mm256_andnot_si256(a, b); }
+    static I shl29(I a) { return _mm256_slli_epi32(a, 29); }
+    static F eq0(I a) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, _mm256_setzero_si256())); }
+    static F cast(I a) { return _mm256_castsi256_ps(a); }
+};
+static const char* KERNEL_NAME = "avx2";
+#else
+struct Lanes {
+    typedef __m128 F;
+    typedef __m128i I;
+    static const size_t width = 4;
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+    static F set(float v) { return _mm_set1_ps(v); }
+    static I seti(int v) { return _mm_set1_epi32(v); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F and_(F a, F b) { return _mm_and_ps(a, b); }
+    static F andnot(F a, F b) { return _mm_andnot_ps(a, b); }
+    static F or_(F a, F b) { return _mm_or_ps(a, b); }
+    static F xor_(F a, F b) { return _mm_xor_ps(a, b); }
+    static I to_int(F a) { return _mm_cvttps_epi32(a); }
+    static F to_float(I a) { return _mm_cvtepi32_ps(a); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static I andnoti(I a, I b) { return _mm_andnot_si128(a, b); }
+    static I shl29(I a) { return _mm_slli_epi32(a, 29); }
+    static F eq0(I a) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, _mm_setzero_si128())); }
+    static F cast(I a) { return _mm_castsi128_ps(a); }
+};
+static const char* KERNEL_NAME = "sse2";
+#endif
+
+// cephes style sincos, about 1 ulp for |angle| < 8192
+static inline void sincos_lanes(Lanes::F angle, Lanes::F* sin_out, Lanes::F* cos_out)
+{
+    typedef Lanes L;
+    const L::F sign_mask = L::set(-0.0f);
+
+    L::F sign_sin = L::and_(angle, sign_mask);
+    L::F x = L::andnot(sign_mask, angle);
+
+    // octant of pi/4, rounded up to an even number
+    L::I j = L::to_int(L::mul(x, L::set(1.27323954473516f)));
+    j = L::andi(L::addi(j, L::seti(1)), L::seti(~1));
+    L::F y = L::to_float(j);
+
+    L::I swap_sin = L::shl29(L::andi(j, L::seti(4)));
+    L::I swap_cos = L::shl29(L::andnoti(L::subi(j, L::seti(2)), L::seti(4)));
+    L::F poly_mask = L::eq0(L::andi(j, L::seti(2)));
+
+    // extended precision x - y * pi/4
+    x = L::sub(x, L::mul(y, L::set(0.78515625f)));
+    x = L::sub(x, L::mul(y, L::set(2.4187564849853515625e-4f)));
+    x = L::sub(x, L::mul(y, L::set(3.77489497744594108e-8f)));
+
+    L::F z = L::mul(x, x);
+    L::F cos_poly = L::set(2.443315711809948e-5f);
+    cos_poly = L::add(L::mul(cos_poly, z), L::set(-1.388731625493765e-3f));
+    cos_poly = L::add(L::mul(cos_poly, z), L::set(4.166664568298827e-2f));
+    cos_poly = L::mul(L::mul(cos_poly, z), z);
+    cos_poly = L::sub(cos_poly, L::mul(z, L::set(0.5f)));
+    cos_poly = L::add(cos_poly, L::set(1.0f));
+
+    L::F sin_poly = L::set(-1.9515295891e-4f);
+    sin_poly = L::add(L::mul(sin_poly, z), L::set(8.3321608736e-3f));
+    sin_poly = L::add(L::mul(sin_poly, z), L::set(-1.6666654611e-1f));
+    sin_poly = L::add(L::mul(L::mul(sin_poly, z), x), x);
+
+    L::F s = L::or_(L::and_(poly_mask, sin_poly), L::andnot(poly_mask, cos_poly));
+    L::F c = L::or_(L::and_(poly_mask, cos_poly), L::andnot(poly_mask, sin_poly));
+
+    *sin_out = L::xor_(s, L::xor_(sign_sin, L::cast(swap_sin)));
+    *cos_out = L::xor_(c, L::cast(swap_cos));
+}
+
+void ExpandLines(const LineParams& lines, Vertex* out, glm::vec3 color)
+{
+    typedef Lanes L;
+    const size_t width = L::width;
+
+    size_t i = 0;
+    for(; i + width <= lines.count; i += width)
+    {
+        L::F x = L::load(lines.x + i);
+        L::F y = L::load(lines.y + i);
+        L::F length = L::load(lines.length + i);
+        L::F thickness = L::load(lines.thickness + i);
+        L::F s, c;
+        sincos_lanes(L::load(lines.angle + i), &s, &c);
+
+        L::F lc = L::mul(length, c);
+        L::F ls = L::mul(length, s);
+        L::F tc = L::mul(thickness, c);
+        L::F ts = L::mul(thickness, s);
+
+        // corners in lane order, Vertex is not a simd friendly stride so they are scattered below
+        alignas(32) float corners[8][width];
+        L::store(corners[0], x);
+        L::store(corners[1], y);
+        L::store(corners[2], L::sub(x, ts));
+        L::store(corners[3], L::add(y, tc));
+        L::store(corners[4], L::sub(L::add(x, lc), ts));
+        L::store(corners[5], L::add(L::add(y, ls), tc));
+        L::store(corners[6], L::add(x, lc));
+        L::store(corners[7], L::add(y, ls));
+
+        Vertex* dst = out + i * 4;
+        for(size_t lane = 0; lane < width; lane++)
+        {
+            write_corner(dst[0], corners[0][lane], corners[1][lane], color);
+            write_corner(dst[1], corners[2][lane], corners[3][lane], color);
+            write_corner(dst[2], corners[4][lane], corners[5][lane], color);
+            write_corner(dst[3], corners[6][lane], corners[7][lane], color);
+            dst += 4;
+        }
+    }
+
+    // remainder
+    for(; i < lines.count; i++)
+    {
+        expand_line(
+            lines.x[i], lines.y[i], lines.length[i], lines.thickness[i],
+            cosf(lines.angle[i]), sinf(lines.angle[i]), out + i * 4, color
+        );
+    }
+}
+
+const char* GetLineKernelName() { return KERNEL_NAME; }
+
+#else
+
+void ExpandLines(const LineParams& lines, Vertex* out, glm::vec3 color)
+{
+    ExpandLinesScalar(lines, out, color);
+}
+
+const char* GetLineKernelName() { return "scalar"; }
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "vertex_buffer.hpp"
+
+// line parameters in structure of arrays form, angles in radians
+struct LineParams {
+    const float* x=nullptr;
+    const float* y=nullptr;
+    const float* length=nullptr;
+    const float* thickness=nullptr;
+    const float* angle=nullptr;
+    size_t count=0;
+};
+
+// writes 4 vertices per line (corner order tr, br, bl, tl like draw_line) to out,
+// which may point straight into mapped memory. uses AVX2 or SSE2 when the
+// compiler targets them and a scalar loop otherwise
+void ExpandLines(const LineParams&, Vertex* out, glm::vec3 color);
+void ExpandLinesScalar(const LineParams&, Vertex* out, glm::vec3 color);
+const char* GetLineKernelName();
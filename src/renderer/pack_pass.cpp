@@ -0,0 +1,190 @@
+#include "pack_pass.hpp"
+
+// invocations per workgroup, local_size_x in pack.comp
+static const uint32_t PACK_GROUP_SIZE = 64;
+
+static bool is_srgb(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+VulkanPackPass::VulkanPackPass(
+        VulkanDevice* device, const std::vector<char>& spirv, VkImageView source,
+        uint32_t width, uint32_t height, VkFormat source_format, ReadbackPacking packing, uint32_t max_sets
+    )
+{
+    m_device = device;
+    m_source = source;
+    m_packing = packing;
+
+    // 4 pixels per invocation, the words past the last pixel are zero filled
+    const VkDeviceSize pixel_count = static_cast<VkDeviceSize>(width) * height;
+    const VkDeviceSize invocations = (pixel_count + 3) / 4;
+    const bool gray = (packing == ReadbackPacking::Gray8);
+    const bool srgb = is_srgb(source_format);
+    if(gray) {
+        m_output_format = srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+        m_output_size = invocations * 4;
+        m_row_pitch = width;
+    } else {
+        m_output_format = srgb ? VK_FORMAT_R8G8B8_SRGB : VK_FORMAT_R8G8B8_UNORM;
+        m_output_size = invocations * 12;
+        m_row_pitch = static_cast<VkDeviceSize>(width) * 3;
+    }
+
+    // rows of at most 65535 groups, the minimum maxComputeWorkGroupCount
+    uint32_t group_count = static_cast<uint32_t>((invocations + PACK_GROUP_SIZE - 1) / PACK_GROUP_SIZE);
+    m_group_count_x = std::max(1u, std::min(group_count, 65535u));
+    m_group_count_y = std::max(1u, (group_count + m_group_count_x - 1) / m_group_count_x);
+
+    m_constants.width = width;
+    m_constants.height = height;
+    m_constants.row_invocations = m_group_count_x * PACK_GROUP_SIZE;
+    m_constants.gray = gray ? 1 : 0;
+    m_constants.srgb = srgb ? 1 : 0;
+
+    printfi("Creating Pack Pass (%s, %llu bytes per image)...\n",
+        gray ? "gray" : "rgb", (unsigned long long) m_output_size
+    );
+
+    VkShaderModuleCreateInfo module_info = init::shader_module_info(spirv.data(), spirv.size());
+    ErrorCheck(vkCreateShaderModule(
+        m_device->GetDevice(), &module_info, nullptr, &m_module
+    ), "Create Pack Shader Module");
+
+    // texelFetch ignores filtering, nearest keeps the sampler valid for every format
+    VkSamplerCreateInfo sampler_info = init::sampler_info();
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.anisotropyEnable = VK_FALSE;
+    sampler_info.maxAnisotropy = 1.0f;
+    ErrorCheck(vkCreateSampler(
+        m_device->GetDevice(), &sampler_info, nullptr, &m_sampler
+    ), "Create Pack Sampler");
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+    ErrorCheck(vkCreateDescriptorSetLayout(
+        m_device->GetDevice(), &layout_info, nullptr, &m_set_layout
+    ), "Create Pack Descriptor Set Layout");
+
+    std::array<VkDescriptorPoolSize, 2> pool_sizes = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = max_sets;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = max_sets;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+    pool_info.maxSets = max_sets;
+    ErrorCheck(vkCreateDescriptorPool(
+        m_device->GetDevice(), &pool_info, nullptr, &m_descriptor_pool
+    ), "Create Pack Descriptor Pool");
+
+    VkPushConstantRange push_constant = {};
+    push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant.offset = 0;
+    push_constant.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = init::pipeline_layout_info();
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &m_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant;
+    ErrorCheck(vkCreatePipelineLayout(
+        m_device->GetDevice(), &pipeline_layout_info, nullptr, &m_pipeline_layout
+    ), "Create Pack Pipeline Layout");
+
+    // TODO: create compute pipeline info in init.hpp
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = init::pipline_shader_stage_info(m_module, VK_SHADER_STAGE_COMPUTE_BIT);
+    pipeline_info.layout = m_pipeline_layout;
+    ErrorCheck(vkCreateComputePipelines(
+        m_device->GetDevice(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline
+    ), "Create Pack Pipeline");
+}
+
+VulkanPackPass::~VulkanPackPass()
+{
+    printfi("-- Destroying Pack Pass...\n");
+    VkDevice device = m_device->GetDevice();
+    vkDestroyPipeline(device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_set_layout, nullptr);
+    vkDestroySampler(device, m_sampler, nullptr);
+    vkDestroyShaderModule(device, m_module, nullptr);
+}
+
+VkDescriptorSet VulkanPackPass::CreateDescriptorSet(VkBuffer output)
+{
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = m_descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &m_set_layout;
+
+    VkDescriptorSet set;
+    ErrorCheck(vkAllocateDescriptorSets(
+        m_device->GetDevice(), &alloc_info, &set
+    ), "Allocate Pack Descriptor Set");
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler = m_sampler;
+    image_info.imageView = m_source;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = output;
+    buffer_info.offset = 0;
+    buffer_info.range = m_output_size;
+
+    std::array<VkWriteDescriptorSet, 2> writes = {};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = set;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &image_info;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = set;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(m_device->GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    return set;
+}
+
+void VulkanPackPass::RecordDispatch(VkCommandBuffer command, VkDescriptorSet set)
+{
+    vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(command, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &m_constants);
+    vkCmdDispatch(command, m_group_count_x, m_group_count_y, 1);
+}
+
+VkDeviceSize VulkanPackPass::GetOutputSize() { return m_output_size; }
+VkDeviceSize VulkanPackPass::GetRowPitch() { return m_row_pitch; }
+VkFormat VulkanPackPass::GetOutputFormat() { return m_output_format; }
+ReadbackPacking VulkanPackPass::GetPacking() { return m_packing; }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "device.hpp"
+
+// what the readback copies to the host
+enum class ReadbackPacking {
+    None, // RGBA8 straight from the color attachment
+    RGB8, // alpha dropped on the gpu, 3/4 of the bytes
+    Gray8 // rec. 709 luma, 1/4 of the bytes
+};
+
+// compute pass that packs the color attachment into a storage buffer before
+// readback. pixels are tightly packed across rows, and BGRA attachments come
+// out as RGB since the shader samples the image
+class VulkanPackPass
+{
+public:
+    // spirv is shader/pack_comp.spv, source reads the color attachment.
+    // max_sets is the number of output buffers CreateDescriptorSet() is called for
+    VulkanPackPass(
+        VulkanDevice*, const std::vector<char>& spirv, VkImageView source,
+        uint32_t width, uint32_t height, VkFormat source_format, ReadbackPacking, uint32_t max_sets
+    );
+    ~VulkanPackPass();
+
+    // binds source and an output buffer of at least GetOutputSize() bytes
+    VkDescriptorSet CreateDescriptorSet(VkBuffer);
+    // source must be in SHADER_READ_ONLY_OPTIMAL, the shader writes are left for the caller to make visible
+    void RecordDispatch(VkCommandBuffer, VkDescriptorSet);
+
+    VkDeviceSize GetOutputSize(); // rounded up to whole words
+    VkDeviceSize GetRowPitch();
+    VkFormat GetOutputFormat();
+    ReadbackPacking GetPacking();
+
+private:
+    struct PushConstants {
+        uint32_t width;
+        uint32_t height;
+        uint32_t row_invocations;
+        uint32_t gray;
+        uint32_t srgb;
+    };
+
+    VulkanDevice* m_device;
+    VkImageView m_source;
+    ReadbackPacking m_packing;
+    VkFormat m_output_format;
+    VkDeviceSize m_output_size;
+    VkDeviceSize m_row_pitch;
+
+    PushConstants m_constants;
+    uint32_t m_group_count_x;
+    uint32_t m_group_count_y;
+
+    VkShaderModule m_module=VK_NULL_HANDLE;
+    VkSampler m_sampler=VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_set_layout=VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptor_pool=VK_NULL_HANDLE;
+    VkPipelineLayout m_pipeline_layout=VK_NULL_HANDLE;
+    VkPipeline m_pipeline=VK_NULL_HANDLE;
+};
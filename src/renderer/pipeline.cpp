@@ -1,12 +1,25 @@
 #include "pipeline.hpp"
 
+// header written in front of the driver's cache blob, so a cache from another
+// device or driver version is thrown away instead of handed to the driver
+struct PipelineCacheHeader {
+    uint32_t magic;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+};
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x43505647; // "GVPC"
+
 VulkanGraphicsPipline::VulkanGraphicsPipline(
-        VulkanDevice* device, uint32_t width, uint32_t height
+        VulkanDevice* device, uint32_t width, uint32_t height, std::string cache_path
     ) 
 {
     m_screen_width = width;
     m_screen_height = height;
     m_device = device;
+    m_cache_path = cache_path;
 }
 
 VulkanGraphicsPipline::~VulkanGraphicsPipline()
@@ -41,7 +54,12 @@ VulkanGraphicsPipline::~VulkanGraphicsPipline()
         printfi("-- Destroying Graphic Pipeline...\n");
         vkDestroyPipeline(m_device->GetDevice(), m_graphics_pipeline, nullptr);
     }
+    if(m_quad_pipeline != NULL) {
+        printfi("-- Destroying Quad Pipeline...\n");
+        vkDestroyPipeline(m_device->GetDevice(), m_quad_pipeline, nullptr);
+    }
     if(m_cache != NULL) {
+        savePipelineCache();
         printfi("-- Destroying Graphic Cache Pipeline...\n");
         vkDestroyPipelineCache(m_device->GetDevice(), m_cache, nullptr);
     }
@@ -55,6 +73,8 @@ VulkanGraphicsPipline::~VulkanGraphicsPipline()
         printfi("-- Destroying Fragmentation Module Pipeline...\n");
         vkDestroyShaderModule(m_device->GetDevice(), m_frag_module, nullptr);
     }
+    if(m_quad_vert_module != 0) vkDestroyShaderModule(m_device->GetDevice(), m_quad_vert_module, nullptr);
+    if(m_quad_frag_module != 0) vkDestroyShaderModule(m_device->GetDevice(), m_quad_frag_module, nullptr);
 
     if(m_descriptor_set_layout != VK_NULL_HANDLE) {
         printfi("-- Destorying Descriptor Layout\n"); // not needed to destory the layout everytime
@@ -65,6 +85,11 @@ VulkanGraphicsPipline::~VulkanGraphicsPipline()
 // TODO: make it more generic
 void VulkanGraphicsPipline::CreateShaderModule(std::string vert_path, std::string frag_path) 
 {
+    if(m_shader_stages.size() > 0) {
+        printfw("Shader modules were already created, replacing shader stages\n");
+        m_shader_stages.clear();
+    }
+
     std::vector<char> vert_shader = read_shader(vert_path);
     std::vector<char> frag_shader = read_shader(frag_path);
 
@@ -85,6 +110,27 @@ void VulkanGraphicsPipline::CreateShaderModule(std::string vert_path, std::strin
     m_shader_stages.push_back(frag_stage_info);
 }
 
+// optional, CreatePipelineLayout() builds the instanced quad pipeline when set
+void VulkanGraphicsPipline::CreateQuadShaderModule(std::string vert_path, std::string frag_path) 
+{
+    if(m_quad_shader_stages.size() > 0) {
+        printfw("Quad shader modules were already created, replacing shader stages\n");
+        m_quad_shader_stages.clear();
+    }
+
+    m_quad_vert_module = createShaderModule(m_device, read_shader(vert_path));
+    m_quad_frag_module = createShaderModule(m_device, read_shader(frag_path));
+
+    m_quad_shader_stages.push_back(init::pipline_shader_stage_info(
+        m_quad_vert_module,
+        VK_SHADER_STAGE_VERTEX_BIT
+    ));
+    m_quad_shader_stages.push_back(init::pipline_shader_stage_info(
+        m_quad_frag_module,
+        VK_SHADER_STAGE_FRAGMENT_BIT
+    ));
+}
+
 // TODO: Cleanup
 void VulkanGraphicsPipline::createDescriptorPool() 
 {
@@ -243,25 +289,79 @@ void VulkanGraphicsPipline::CreatePipelineLayout(uint32_t width, uint32_t height
     createDescriptorLayout();
 
     // cache pipeline
-    VkPipelineCacheCreateInfo cache_info = {};
-    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    ErrorCheck(vkCreatePipelineCache(
-        m_device->GetDevice(), &cache_info, nullptr, &m_cache
-    ), "Create Cache Pipeline");
-
-
-    // Input Assembly
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = init::pipeline_input_assembly_state_info();
+    if(m_cache == NULL) {
+        createPipelineCache();
+    }
 
     // Vertex
     auto binding_description = Vertex::getBindingDescription();
     auto attribute_description = Vertex::getAttributeDescriptions();
+    if(m_vertex_format == VertexFormat::Packed) {
+        binding_description = PackedVertex::getBindingDescription();
+        attribute_description = PackedVertex::getAttributeDescriptions();
+    }
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info = init::pipeline_vertex_input_state_info(
         attribute_description.data(), static_cast<uint32_t>(attribute_description.size()), 
         &binding_description, 1
     );
 
+    // Pipeline Layout - projection goes in as a push constant, vertices stay in pixels
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = init::pipeline_layout_info();
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &m_descriptor_set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+    // origin in the top left corner, same as the old projOrtho in main.cpp
+    const float wf = static_cast<float>(width);
+    const float hf = static_cast<float>(height);
+    m_push_constants.projection = glm::ortho(0.0f, wf, hf, 0.0f, -5.0f, 5.0f);
+    
+    ErrorCheck(vkCreatePipelineLayout(
+        m_device->GetDevice(),
+        &pipeline_layout_info,
+        nullptr,
+        &m_pipeline_layout
+    ), "Create Pipeline Layout");
+
+    m_graphics_pipeline = createGraphicsPipeline(m_shader_stages, &vertex_input_info);
+
+    // instanced quads share the layout and render pass
+    if(m_quad_shader_stages.size() > 0)
+    {
+        auto quad_bindings = QuadInstance::getBindingDescriptions();
+        auto quad_attributes = QuadInstance::getAttributeDescriptions();
+        VkPipelineVertexInputStateCreateInfo quad_input_info = init::pipeline_vertex_input_state_info(
+            quad_attributes.data(), static_cast<uint32_t>(quad_attributes.size()),
+            quad_bindings.data(), static_cast<uint32_t>(quad_bindings.size())
+        );
+        m_quad_pipeline = createGraphicsPipeline(m_quad_shader_stages, &quad_input_info);
+    }
+
+    vkDestroyShaderModule(m_device->GetDevice(), m_vert_module, nullptr);
+    vkDestroyShaderModule(m_device->GetDevice(), m_frag_module, nullptr);
+    vkDestroyShaderModule(m_device->GetDevice(), m_quad_vert_module, nullptr);
+    vkDestroyShaderModule(m_device->GetDevice(), m_quad_frag_module, nullptr);
+    m_vert_module = 0;
+    m_frag_module = 0;
+    m_quad_vert_module = 0;
+    m_quad_frag_module = 0;
+}
+
+VkPipeline VulkanGraphicsPipline::createGraphicsPipeline(
+        std::vector<VkPipelineShaderStageCreateInfo>& shader_stages,
+        VkPipelineVertexInputStateCreateInfo* vertex_input_info
+    )
+{
+    // Input Assembly
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = init::pipeline_input_assembly_state_info();
+
     // Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizer_info = init::pipeline_rasterization_state_info();
 
@@ -297,22 +397,9 @@ void VulkanGraphicsPipline::CreatePipelineLayout(uint32_t width, uint32_t height
     };
     VkPipelineDynamicStateCreateInfo dynamic_state_info = init::pipeline_dynamic_state_info(dynamic_state);
 
-    // Pipeline Layout - Low-Key Disabled (used for passing uniforms)
-    // TODO: enable layout for uniforms
-    VkPipelineLayoutCreateInfo pipeline_layout_info = init::pipeline_layout_info();
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &m_descriptor_set_layout;
-    
-    ErrorCheck(vkCreatePipelineLayout(
-        m_device->GetDevice(),
-        &pipeline_layout_info,
-        nullptr,
-        &m_pipeline_layout
-    ), "Create Pipeline Layout");
-
     VkGraphicsPipelineCreateInfo pipeline_info = init::graphics_pipeline_info(
-        m_shader_stages.data(), static_cast<uint32_t>(m_shader_stages.size()),
-        &vertex_input_info,
+        shader_stages.data(), static_cast<uint32_t>(shader_stages.size()),
+        vertex_input_info,
         &input_assembly_info,
         &viewport_state_info,
         &rasterizer_info,
@@ -326,17 +413,79 @@ void VulkanGraphicsPipline::CreatePipelineLayout(uint32_t width, uint32_t height
     VkPipeline graphics_pipeline;
     ErrorCheck(vkCreateGraphicsPipelines(
         m_device->GetDevice(),
-        VK_NULL_HANDLE, 1,
+        m_cache, 1,
         &pipeline_info, nullptr,
         &graphics_pipeline
     ), "Create Graphics Pipelines");
 
-    m_graphics_pipeline = graphics_pipeline;
+    return graphics_pipeline;
+}
 
-    vkDestroyShaderModule(m_device->GetDevice(), m_vert_module, nullptr);
-    vkDestroyShaderModule(m_device->GetDevice(), m_frag_module, nullptr);
-    m_vert_module = 0;
-    m_frag_module = 0;
+void VulkanGraphicsPipline::createPipelineCache() 
+{
+    VkPhysicalDeviceProperties& properties = m_device->GetPhysicalDevice()->GetProperties();
+
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    std::vector<char> file_data;
+    if(!m_cache_path.empty() && read_binary(m_cache_path, file_data))
+    {
+        PipelineCacheHeader header = {};
+        bool valid = file_data.size() >= sizeof(header);
+        if(valid) {
+            memcpy(&header, file_data.data(), sizeof(header));
+            valid = header.magic == PIPELINE_CACHE_MAGIC &&
+                header.vendor_id == properties.vendorID &&
+                header.device_id == properties.deviceID &&
+                header.driver_version == properties.driverVersion &&
+                memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+                header.data_size == file_data.size() - sizeof(header);
+        }
+
+        if(valid) {
+            printfi("Seeding Pipeline Cache from %s (%llu bytes)...\n", m_cache_path.c_str(), (unsigned long long) header.data_size);
+            cache_info.initialDataSize = static_cast<size_t>(header.data_size);
+            cache_info.pInitialData = file_data.data() + sizeof(header);
+        } else {
+            printfw("Ignoring stale pipeline cache %s\n", m_cache_path.c_str());
+        }
+    }
+
+    ErrorCheck(vkCreatePipelineCache(
+        m_device->GetDevice(), &cache_info, nullptr, &m_cache
+    ), "Create Cache Pipeline");
+}
+
+void VulkanGraphicsPipline::savePipelineCache() 
+{
+    if(m_cache_path.empty()) return;
+
+    size_t data_size = 0;
+    ErrorCheck(vkGetPipelineCacheData(
+        m_device->GetDevice(), m_cache, &data_size, nullptr
+    ), "Get Pipeline Cache Size");
+    if(data_size == 0) return;
+
+    VkPhysicalDeviceProperties& properties = m_device->GetPhysicalDevice()->GetProperties();
+    PipelineCacheHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.vendor_id = properties.vendorID;
+    header.device_id = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::vector<char> file_data(sizeof(header) + data_size);
+    ErrorCheck(vkGetPipelineCacheData(
+        m_device->GetDevice(), m_cache, &data_size, file_data.data() + sizeof(header)
+    ), "Get Pipeline Cache Data");
+    header.data_size = data_size;
+    memcpy(file_data.data(), &header, sizeof(header));
+
+    printfi("Saving Pipeline Cache to %s (%llu bytes)...\n", m_cache_path.c_str(), (unsigned long long) data_size);
+    if(!write_binary(m_cache_path, file_data.data(), sizeof(header) + data_size)) {
+        printfw("Failed to write pipeline cache %s\n", m_cache_path.c_str());
+    }
 }
 
 void VulkanGraphicsPipline::CreateFrameBuffers(uint32_t count, std::vector<VkImageView> image_views, VkImageView* depth_view) 
@@ -376,7 +525,8 @@ void VulkanGraphicsPipline::CreateFrameBuffers(uint32_t count, std::vector<VkIma
 void VulkanGraphicsPipline::CreateCommandBuffers(
         VkCommandBuffer* buffers,
         uint32_t count,
-        VulkanVertexBuffer* vertex_buffer
+        VulkanVertexBuffer* vertex_buffer,
+        VulkanQuadBatch* quad_batch
     )
 {
     printfi("Create Command Buffer...\n");
@@ -410,48 +560,117 @@ void VulkanGraphicsPipline::CreateCommandBuffers(
             &begin_info
         ), "Create Begin Command Buffer");
 
-        VkClearValue clear_values[2]; 
-        clear_values[0].color = {1.0f, 1.0f, 1.0f, 1.0f};
-        clear_values[1].depthStencil = {1.0f, 0};
-        VkRect2D render_area;
-        render_area.offset = {0, 0};
-        render_area.extent = {m_screen_width, m_screen_height};
-        VkRenderPassBeginInfo render_pass_info = init::render_pass_begin_info(
-            m_render_pass,
-            render_area,
-            m_frame_buffers[i],
-            clear_values, 2
-        );
+        RecordRenderPass(buffers[i], i, vertex_buffer, quad_batch);
 
-        vkCmdBeginRenderPass(buffers[i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+        ErrorCheck(vkEndCommandBuffer(
+            buffers[i]
+        ), "End Command Buffer");
+    }
+}
 
-            VkViewport viewport = {};
-            viewport.height = (float) m_screen_height;
-            viewport.width = (float) m_screen_width;
-            viewport.minDepth = (float) 0.0f;
-            viewport.maxDepth = (float) 1.0f;
-            vkCmdSetViewport(buffers[i], 0, 1, &viewport);
+// records the render pass into an already begun command buffer,
+// any geometry source may be null
+void VulkanGraphicsPipline::RecordRenderPass(
+        VkCommandBuffer buffer,
+        uint32_t frame_index,
+        VulkanVertexBuffer* vertex_buffer,
+        VulkanQuadBatch* quad_batch,
+        VulkanDynamicBuffer* dynamic_buffer,
+        VulkanQuadBatch* scene_batch
+    )
+{
+    if(m_render_pass == NULL) {
+        printff("Can not record render pass without render pass!\n");
+    }
+    if(frame_index >= m_frame_buffers.size()) {
+        printff("Can not record render pass without frame buffer %d!\n", frame_index);
+    }
 
-            VkRect2D scissor = {};
-            scissor.extent = { m_screen_width, m_screen_height };
-            vkCmdSetScissor(buffers[i], 0, 1, &scissor);
+    uint32_t draws = 0;
+
+    VkClearValue clear_values[2]; 
+    clear_values[0].color = {1.0f, 1.0f, 1.0f, 1.0f};
+    clear_values[1].depthStencil = {1.0f, 0};
+    VkRect2D render_area;
+    render_area.offset = {0, 0};
+    render_area.extent = {m_screen_width, m_screen_height};
+    VkRenderPassBeginInfo render_pass_info = init::render_pass_begin_info(
+        m_render_pass,
+        render_area,
+        m_frame_buffers[frame_index],
+        clear_values, 2
+    );
 
-            vkCmdBindPipeline(buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics_pipeline);
-            vkCmdSetLineWidth(buffers[i], 1.0f);
+    vkCmdBeginRenderPass(buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport = {};
+        viewport.height = (float) m_screen_height;
+        viewport.width = (float) m_screen_width;
+        viewport.minDepth = (float) 0.0f;
+        viewport.maxDepth = (float) 1.0f;
+        vkCmdSetViewport(buffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.extent = { m_screen_width, m_screen_height };
+        vkCmdSetScissor(buffer, 0, 1, &scissor);
+
+        vkCmdSetLineWidth(buffer, 1.0f);
+        vkCmdPushConstants(
+            buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+            0, sizeof(PushConstants), &m_push_constants
+        );
+
+        if(vertex_buffer != nullptr)
+        {
+            if(vertex_buffer->GetFormat() != m_vertex_format) {
+                printff("Vertex buffer format does not match the pipeline!\n");
+            }
+            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics_pipeline);
 
             VkBuffer vertex_buffers[] = {vertex_buffer->GetVertexBuffer()};
             VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(buffers[i], 0, 1, vertex_buffers, offsets);
-            vkCmdBindIndexBuffer(buffers[i], vertex_buffer->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+            vkCmdBindVertexBuffers(buffer, 0, 1, vertex_buffers, offsets);
+            vkCmdBindIndexBuffer(buffer, vertex_buffer->GetIndexBuffer(), 0, vertex_buffer->GetIndexType());
+
+            for(auto& range : vertex_buffer->GetDrawRanges()) {
+                vkCmdDrawIndexed(buffer, range.index_count, 1, range.first_index, range.vertex_offset, 0); // and... we finally made it
+                draws++;
+            }
+        }
+
+        if(dynamic_buffer != nullptr && dynamic_buffer->GetIndexCount() > 0)
+        {
+            if(dynamic_buffer->GetFormat() != m_vertex_format) {
+                printff("Dynamic buffer format does not match the pipeline!\n");
+            }
+            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics_pipeline);
+            dynamic_buffer->Record(buffer);
+            draws++;
+        }
+
+        for(VulkanQuadBatch* batch : {quad_batch, scene_batch})
+        {
+            if(batch == nullptr || batch->GetInstanceCount() == 0) continue;
+            if(m_quad_pipeline == NULL) {
+                printff("Can not draw quads without the quad pipeline!\n");
+            }
+            vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_quad_pipeline);
+            batch->Record(buffer);
+            draws++;
+        }
+    
+    vkCmdEndRenderPass(buffer);
 
-            vkCmdDrawIndexed(buffers[i], static_cast<uint32_t>(vertex_buffer->GetIndices().size()), 1, 0, 0, 0); // and... we finally made it
-        
-        vkCmdEndRenderPass(buffers[i]);
-        ErrorCheck(vkEndCommandBuffer(
-            buffers[i]
-        ), "End Command Buffer");
-    }
+    m_recorded_draws[buffer] = draws;
+}
+
+uint32_t VulkanGraphicsPipline::GetRecordedDraws(VkCommandBuffer buffer)
+{
+    auto it = m_recorded_draws.find(buffer);
+    return (it != m_recorded_draws.end()) ? it->second : 0;
 }
+void VulkanGraphicsPipline::SetProjection(glm::mat4 projection) { m_push_constants.projection = projection; }
+void VulkanGraphicsPipline::SetVertexFormat(VertexFormat format) { m_vertex_format = format; }
 
 VkShaderModule VulkanGraphicsPipline::createShaderModule(VulkanDevice* device, const std::vector<char> shader_code) 
 {
@@ -3,21 +3,38 @@
 #include "build_order.hpp"
 #include "device.hpp"
 #include "vertex_buffer.hpp"
+#include "quad_batch.hpp"
+#include "dynamic_buffer.hpp"
 
 struct Vertex;
 class VulkanDevice;
 class VulkanVertexBuffer;
+class VulkanQuadBatch;
+class VulkanDynamicBuffer;
+
+// mirrors the push_constant block in basic.vert
+struct PushConstants {
+    glm::mat4 projection; // pixels to clip space
+};
 
 class VulkanGraphicsPipline
 {
 public:
-    VulkanGraphicsPipline(VulkanDevice*, uint32_t, uint32_t);
+    VulkanGraphicsPipline(VulkanDevice*, uint32_t, uint32_t, std::string cache_path="");
     ~VulkanGraphicsPipline();
     void CreateShaderModule(std::string, std::string);
+    void CreateQuadShaderModule(std::string, std::string);
     void CreatePipelineLayout(uint32_t, uint32_t);
     void CreateRenderPass(VkFormat, VkFormat, bool);
     void CreateFrameBuffers(uint32_t, std::vector<VkImageView>, VkImageView* depth_view=nullptr); 
-    void CreateCommandBuffers(VkCommandBuffer*, uint32_t, VulkanVertexBuffer*);
+    void CreateCommandBuffers(VkCommandBuffer*, uint32_t, VulkanVertexBuffer*, VulkanQuadBatch* quad_batch=nullptr);
+    void RecordRenderPass(
+        VkCommandBuffer, uint32_t, VulkanVertexBuffer*, VulkanQuadBatch* quad_batch=nullptr,
+        VulkanDynamicBuffer* dynamic_buffer=nullptr, VulkanQuadBatch* scene_batch=nullptr
+    );
+    uint32_t GetRecordedDraws(VkCommandBuffer); // draws in the last recording of the buffer
+    void SetProjection(glm::mat4); // picked up by the next RecordRenderPass
+    void SetVertexFormat(VertexFormat); // must match the shader, set before CreatePipelineLayout
     
 private:
     uint32_t  m_screen_width;
@@ -26,25 +43,36 @@ private:
     // TODO: create VkShaderModule std::vector
     VkShaderModule m_vert_module=0;
     VkShaderModule m_frag_module=0;
+    VkShaderModule m_quad_vert_module=0;
+    VkShaderModule m_quad_frag_module=0;
     
     std::vector<VkPipelineShaderStageCreateInfo> m_shader_stages;
+    std::vector<VkPipelineShaderStageCreateInfo> m_quad_shader_stages;
     VkPipelineCache m_cache = NULL;
+    std::string m_cache_path;
     VkPipelineLayout m_pipeline_layout=NULL;
     VkPipeline m_graphics_pipeline=NULL;
+    VkPipeline m_quad_pipeline=NULL;
 
     VkRenderPass m_render_pass=NULL;
     std::vector<VkFramebuffer> m_frame_buffers;
     
     VkCommandBuffer* m_command_buffers;
     uint32_t m_command_buffer_count=0;
+    std::map<VkCommandBuffer, uint32_t> m_recorded_draws;
+    PushConstants m_push_constants;
+    VertexFormat m_vertex_format=VertexFormat::Standard;
     
     std::vector<VkImageView> m_imageviews;
     VkDescriptorSetLayout m_descriptor_set_layout=VK_NULL_HANDLE;
     VkDescriptorPool m_descriptor_pool;
     std::vector<VkDescriptorSet> m_descriptor_sets;
     
+    void createPipelineCache();
+    void savePipelineCache();
     void createDescriptorPool();
     void createDescriptorSets(VkSampler, VkImageView);
     void createDescriptorLayout();
+    VkPipeline createGraphicsPipeline(std::vector<VkPipelineShaderStageCreateInfo>&, VkPipelineVertexInputStateCreateInfo*);
     VkShaderModule createShaderModule(VulkanDevice*, const std::vector<char>);
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "quad_batch.hpp"
+
+// same corner order as the device's shared quad indices
+static const glm::vec2 UNIT_QUAD[4] = {
+    {0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}
+};
+
+VulkanQuadBatch::VulkanQuadBatch(VulkanDevice* device, const std::vector<QuadInstance>& instances)
+{
+    m_device = device;
+    m_instance_count = static_cast<uint32_t>(instances.size());
+    m_capacity = m_instance_count;
+
+    printfi("Creating Quad Batch of %d instances...\n", m_instance_count);
+    createBuffer(
+        UNIT_QUAD, sizeof(UNIT_QUAD),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &m_quad_buffer, &m_quad_buffer_memory
+    );
+    if(m_instance_count > 0) {
+        createBuffer(
+            instances.data(), sizeof(QuadInstance) * instances.size(),
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &m_instance_buffer, &m_instance_buffer_memory
+        );
+    }
+    m_device->GetStagingRing()->Flush();
+}
+
+VulkanQuadBatch::VulkanQuadBatch(VulkanDevice* device, uint32_t capacity)
+{
+    m_device = device;
+    m_capacity = capacity;
+
+    printfi("Creating Quad Batch with room for %d instances...\n", m_capacity);
+    createBuffer(
+        UNIT_QUAD, sizeof(UNIT_QUAD),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &m_quad_buffer, &m_quad_buffer_memory
+    );
+    if(m_capacity > 0) {
+        m_device->CreateBuffer(
+            sizeof(QuadInstance) * m_capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_instance_buffer, &m_instance_buffer_memory
+        );
+    }
+    m_device->GetStagingRing()->Flush();
+}
+
+VulkanQuadBatch::~VulkanQuadBatch()
+{
+    printfi("-- Destroying Quad Batch...\n");
+    if(m_instance_buffer != VK_NULL_HANDLE) {
+        m_device->DestroyBuffer(m_instance_buffer, m_instance_buffer_memory);
+    }
+    m_device->DestroyBuffer(m_quad_buffer, m_quad_buffer_memory);
+}
+
+uint32_t VulkanQuadBatch::GetInstanceCount()
+{
+    return (m_source_buffer == VK_NULL_HANDLE) ? m_instance_count : m_source_count;
+}
+uint32_t VulkanQuadBatch::GetCapacity() { return m_capacity; }
+VkBuffer VulkanQuadBatch::GetInstanceBuffer() { return m_instance_buffer; }
+
+void VulkanQuadBatch::SetInstanceCount(uint32_t count)
+{
+    if(count > m_capacity) {
+        printfw("Quad batch count %d is above its capacity %d\n", count, m_capacity);
+        count = m_capacity;
+    }
+    m_instance_count = count;
+}
+
+void VulkanQuadBatch::SetInstanceSource(VkBuffer buffer, VkDeviceSize offset, uint32_t count)
+{
+    m_source_buffer = buffer;
+    m_source_offset = offset;
+    m_source_count = count;
+}
+
+void VulkanQuadBatch::Record(VkCommandBuffer buffer)
+{
+    bool own = m_source_buffer == VK_NULL_HANDLE;
+    uint32_t count = GetInstanceCount();
+    if(count == 0) return;
+
+    VkBuffer vertex_buffers[] = {m_quad_buffer, own ? m_instance_buffer : m_source_buffer};
+    VkDeviceSize offsets[] = {0, own ? 0 : m_source_offset};
+    vkCmdBindVertexBuffers(buffer, 0, 2, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(buffer, m_device->GetQuadIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+
+    vkCmdDrawIndexed(buffer, 6, count, 0, 0, 0);
+}
+
+void VulkanQuadBatch::createBuffer(
+        const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+        VkBuffer* buffer, MemoryAllocation* buffer_memory
+    )
+{
+    m_device->CreateBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory
+    );
+
+    m_device->GetStagingRing()->UploadBuffer(*buffer, data, size);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "device.hpp"
+#include "memory_allocator.hpp"
+
+// one line or rectangle, expanded from a unit quad in quad.vert
+struct QuadInstance {
+    glm::vec2 pos;   // pixels, corner the quad rotates around
+    float length;
+    float thickness;
+    float angle;     // radians
+    uint32_t color;  // RGBA8, see PackColor
+
+    static uint32_t PackColor(glm::vec3 color, float alpha=1.0f)
+    {
+        auto to_byte = [](float v) {
+            return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+        };
+        return to_byte(color.x) | to_byte(color.y) << 8 | to_byte(color.z) << 16 | to_byte(alpha) << 24;
+    }
+
+    // binding 0 is the unit quad, binding 1 steps once per instance
+    static std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions()
+    {
+        std::array<VkVertexInputBindingDescription, 2> binding_descriptions;
+        binding_descriptions[0].binding = 0;
+        binding_descriptions[0].stride = sizeof(glm::vec2);
+        binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        binding_descriptions[1].binding = 1;
+        binding_descriptions[1].stride = sizeof(QuadInstance);
+        binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return binding_descriptions;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = 0;
+
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(QuadInstance, pos);
+
+        // length, thickness and angle
+        attributeDescriptions[2].binding = 1;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(QuadInstance, length);
+
+        attributeDescriptions[3].binding = 1;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[3].offset = offsetof(QuadInstance, color);
+        return attributeDescriptions;
+    }
+};
+
+class VulkanDevice;
+
+// instance buffer plus the unit quad it is expanded from, drawn with a single
+// instanced vkCmdDrawIndexed
+class VulkanQuadBatch
+{
+public:
+    VulkanQuadBatch(VulkanDevice*, const std::vector<QuadInstance>&);
+    // empty instance buffer the owner fills through the staging ring
+    VulkanQuadBatch(VulkanDevice*, uint32_t capacity);
+    ~VulkanQuadBatch();
+
+    uint32_t GetInstanceCount(); // drawn by the next Record
+    uint32_t GetCapacity();
+    VkBuffer GetInstanceBuffer();
+    void SetInstanceCount(uint32_t); // takes effect on the next Record
+    // draws count instances from another buffer instead, e.g. a culled copy. null restores the own buffer
+    void SetInstanceSource(VkBuffer, VkDeviceSize offset=0, uint32_t count=0);
+    void Record(VkCommandBuffer); // quad pipeline must already be bound
+
+private:
+    VulkanDevice* m_device;
+    VkBuffer m_quad_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_quad_buffer_memory;
+    VkBuffer m_instance_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_instance_buffer_memory;
+    uint32_t m_instance_count=0;
+    uint32_t m_capacity=0;
+    VkBuffer m_source_buffer=VK_NULL_HANDLE;
+    VkDeviceSize m_source_offset=0;
+    uint32_t m_source_count=0;
+
+    void createBuffer(const void*, VkDeviceSize, VkBufferUsageFlags, VkBuffer*, MemoryAllocation*);
+};
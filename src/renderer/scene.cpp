@@ -0,0 +1,343 @@
+#include "scene.hpp"
+
+static QuadInstance make_line(float x, float y, float length, float size, float angle, uint32_t color)
+{
+    QuadInstance quad;
+    quad.pos = {x, y};
+    quad.length = length;
+    quad.thickness = size;
+    quad.angle = glm::radians(angle);
+    quad.color = color;
+    return quad;
+}
+
+// every corner of the rotated quad
+static Bounds quad_bounds(const QuadInstance& quad)
+{
+    float c = cosf(quad.angle);
+    float s = sinf(quad.angle);
+    const float corners[4][2] = {
+        {0.0f, 0.0f}, {0.0f, quad.thickness}, {quad.length, quad.thickness}, {quad.length, 0.0f}
+    };
+
+    Bounds bounds = {quad.pos.x, quad.pos.y, quad.pos.x, quad.pos.y};
+    for(auto& corner : corners)
+    {
+        float x = quad.pos.x + corner[0] * c - corner[1] * s;
+        float y = quad.pos.y + corner[0] * s + corner[1] * c;
+        bounds.min_x = std::min(bounds.min_x, x);
+        bounds.min_y = std::min(bounds.min_y, y);
+        bounds.max_x = std::max(bounds.max_x, x);
+        bounds.max_y = std::max(bounds.max_y, y);
+    }
+    return bounds;
+}
+
+// per frame, more ranges than this are replaced by a single full copy
+static const size_t MAX_PENDING_RANGES = 4096;
+
+VulkanScene::VulkanScene(VulkanDevice* device, uint32_t capacity, uint32_t frame_count)
+{
+    m_device = device;
+    m_frame_count = std::max(1u, frame_count);
+    for(uint32_t i = 0; i < m_frame_count; i++) {
+        m_batches.push_back(new VulkanQuadBatch(m_device, capacity));
+    }
+    m_pending.resize(m_frame_count);
+    m_instances.resize(capacity);
+}
+
+VulkanScene::~VulkanScene()
+{
+    if(m_visible_buffer != VK_NULL_HANDLE) {
+        m_device->DestroyBuffer(m_visible_buffer, m_visible_memory);
+    }
+    for(auto batch : m_batches) delete batch;
+}
+
+ShapeHandle VulkanScene::AddLine(float x, float y, float length, float size, float angle, glm::vec3 color)
+{
+    Shape shape;
+    shape.type = ShapeType::Line;
+    shape.x = x;
+    shape.y = y;
+    shape.width = length;
+    shape.height = 0.0f;
+    shape.size = size;
+    shape.angle = angle;
+    shape.color = color;
+    shape.count = 1;
+    return add(shape);
+}
+
+ShapeHandle VulkanScene::AddBox(float x, float y, float w, float h, float size, glm::vec3 color)
+{
+    Shape shape;
+    shape.type = ShapeType::Box;
+    shape.x = x;
+    shape.y = y;
+    shape.width = w;
+    shape.height = h;
+    shape.size = size;
+    shape.angle = 0.0f;
+    shape.color = color;
+    shape.count = 4;
+    return add(shape);
+}
+
+void VulkanScene::SetLine(ShapeHandle handle, float x, float y, float length, float size, float angle)
+{
+    Shape* shape = get(handle);
+    if(shape == nullptr || shape->type != ShapeType::Line) return;
+    shape->x = x;
+    shape->y = y;
+    shape->width = length;
+    shape->size = size;
+    shape->angle = angle;
+    markDirty(handle);
+}
+
+void VulkanScene::SetBox(ShapeHandle handle, float x, float y, float w, float h, float size)
+{
+    Shape* shape = get(handle);
+    if(shape == nullptr || shape->type != ShapeType::Box) return;
+    shape->x = x;
+    shape->y = y;
+    shape->width = w;
+    shape->height = h;
+    shape->size = size;
+    markDirty(handle);
+}
+
+void VulkanScene::SetColor(ShapeHandle handle, glm::vec3 color)
+{
+    Shape* shape = get(handle);
+    if(shape == nullptr) return;
+    shape->color = color;
+    markDirty(handle);
+}
+
+void VulkanScene::Remove(ShapeHandle handle)
+{
+    Shape* shape = get(handle);
+    if(shape == nullptr) return;
+
+    // zero thickness quads are culled as degenerate triangles
+    for(uint32_t i = shape->first; i < shape->first + shape->count; i++) {
+        m_instances[i] = QuadInstance();
+    }
+    shape->alive = false;
+    if(shape->indexed) {
+        m_grid.Remove(handle, shape->bounds);
+        shape->indexed = false;
+    }
+    m_removed.push_back({shape->first * sizeof(QuadInstance), shape->count * sizeof(QuadInstance)});
+
+    m_free_slots[shape->count].push_back(shape->first);
+    m_free_handles.push_back(handle);
+    m_shape_count--;
+}
+
+bool VulkanScene::IsDirty() { return m_dirty.size() > 0 || m_removed.size() > 0; }
+
+UploadTicket VulkanScene::Update(uint32_t frame)
+{
+    VulkanStagingRing* ring = m_device->GetStagingRing();
+
+    // new edits are expanded once and queued for every frame's buffer
+    if(IsDirty())
+    {
+        std::vector<UploadRange> edited;
+        edited.swap(m_removed);
+        edited.reserve(edited.size() + m_dirty.size());
+        for(ShapeHandle handle : m_dirty)
+        {
+            Shape& shape = m_shapes[handle];
+            shape.dirty = false;
+            if(!shape.alive) continue;
+            expand(shape);
+            index(handle);
+            edited.push_back({shape.first * sizeof(QuadInstance), shape.count * sizeof(QuadInstance)});
+        }
+        m_dirty.clear();
+        // a frame that is not drawn for a while gets one copy of the whole scene instead
+        for(auto& pending : m_pending)
+        {
+            pending.insert(pending.end(), edited.begin(), edited.end());
+            if(pending.size() > MAX_PENDING_RANGES) {
+                pending.clear();
+                if(m_slot_end > 0) pending.push_back({0, m_slot_end * sizeof(QuadInstance)});
+            }
+        }
+    }
+
+    VulkanQuadBatch* batch = m_batches[frame % m_frame_count];
+    std::vector<UploadRange>& ranges = m_pending[frame % m_frame_count];
+    batch->SetInstanceCount(m_slot_end);
+    if(ranges.empty()) return ring->Flush();
+
+    // neighbouring slots become one copy region
+    std::sort(ranges.begin(), ranges.end(), [](const UploadRange& a, const UploadRange& b) {
+        return a.offset < b.offset;
+    });
+    size_t merged = 0;
+    for(size_t i = 1; i < ranges.size(); i++)
+    {
+        UploadRange& last = ranges[merged];
+        if(ranges[i].offset <= last.offset + last.size) {
+            last.size = std::max(last.size, ranges[i].offset + ranges[i].size - last.offset);
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(merged + 1);
+
+    ring->UploadRanges(
+        batch->GetInstanceBuffer(), m_instances.data(),
+        ranges.data(), static_cast<uint32_t>(ranges.size())
+    );
+    ranges.clear();
+    return ring->Flush();
+}
+
+void VulkanScene::SetView(const Bounds& view)
+{
+    m_view = view;
+    m_has_view = true;
+}
+
+void VulkanScene::ClearView() { m_has_view = false; }
+
+uint32_t VulkanScene::Cull(uint32_t frame)
+{
+    VulkanQuadBatch* batch = m_batches[frame % m_frame_count];
+    if(!m_has_view)
+    {
+        batch->SetInstanceSource(VK_NULL_HANDLE);
+        return m_shape_count;
+    }
+
+    uint32_t capacity = batch->GetCapacity();
+    if(m_visible_buffer == VK_NULL_HANDLE)
+    {
+        m_device->CreateBuffer(
+            sizeof(QuadInstance) * capacity * m_frame_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &m_visible_buffer, &m_visible_memory
+        );
+    }
+
+    m_visible.clear();
+    m_grid.Query(m_view, m_visible);
+
+    // keep the order shapes are drawn in without culling
+    std::sort(m_visible.begin(), m_visible.end(), [this](ShapeHandle a, ShapeHandle b) {
+        return m_shapes[a].first < m_shapes[b].first;
+    });
+
+    VkDeviceSize region = static_cast<VkDeviceSize>(capacity) * (frame % m_frame_count);
+    QuadInstance* dst = (QuadInstance*) m_visible_memory.mapped + region;
+    uint32_t count = 0;
+    for(ShapeHandle handle : m_visible)
+    {
+        const Shape& shape = m_shapes[handle];
+        memcpy(dst + count, &m_instances[shape.first], sizeof(QuadInstance) * shape.count);
+        count += shape.count;
+    }
+
+    batch->SetInstanceSource(m_visible_buffer, region * sizeof(QuadInstance), count);
+    return static_cast<uint32_t>(m_visible.size());
+}
+
+uint32_t VulkanScene::GetShapeCount() { return m_shape_count; }
+VulkanQuadBatch* VulkanScene::GetQuadBatch(uint32_t frame) { return m_batches[frame % m_frame_count]; }
+
+ShapeHandle VulkanScene::add(const Shape& new_shape)
+{
+    // slots freed by a shape of the same size are reused before growing
+    uint32_t first;
+    auto free_slots = m_free_slots.find(new_shape.count);
+    if(free_slots != m_free_slots.end() && free_slots->second.size() > 0) {
+        first = free_slots->second.back();
+        free_slots->second.pop_back();
+    } else if(m_slot_end + new_shape.count <= static_cast<uint32_t>(m_instances.size())) {
+        first = m_slot_end;
+        m_slot_end += new_shape.count;
+    } else {
+        printfw("Scene is full, shape dropped\n");
+        return INVALID_SHAPE;
+    }
+
+    ShapeHandle handle;
+    if(m_free_handles.size() > 0) {
+        handle = m_free_handles.back();
+        m_free_handles.pop_back();
+    } else {
+        handle = static_cast<ShapeHandle>(m_shapes.size());
+        m_shapes.emplace_back();
+    }
+
+    // a reused handle may still be queued from before its Remove()
+    Shape& shape = m_shapes[handle];
+    bool queued = shape.dirty;
+    shape = new_shape;
+    shape.first = first;
+    shape.alive = true;
+    shape.dirty = queued;
+    markDirty(handle);
+    m_shape_count++;
+    return handle;
+}
+
+VulkanScene::Shape* VulkanScene::get(ShapeHandle handle)
+{
+    if(handle >= m_shapes.size() || !m_shapes[handle].alive) {
+        printfw("Invalid shape handle %d\n", handle);
+        return nullptr;
+    }
+    return &m_shapes[handle];
+}
+
+void VulkanScene::markDirty(ShapeHandle handle)
+{
+    Shape& shape = m_shapes[handle];
+    if(shape.dirty) return;
+    shape.dirty = true;
+    m_dirty.push_back(handle);
+}
+
+void VulkanScene::expand(const Shape& shape)
+{
+    QuadInstance* dst = &m_instances[shape.first];
+    uint32_t color = QuadInstance::PackColor(shape.color);
+    float x = shape.x, y = shape.y, w = shape.width, h = shape.height, size = shape.size;
+
+    if(shape.type == ShapeType::Line) {
+        dst[0] = make_line(x, y, w, size, shape.angle, color);
+        return;
+    }
+
+    // same four lines as draw_box
+    dst[0] = make_line(x, y, w, size, 0, color);
+    dst[1] = make_line(x+w-size, y, h, size, -90, color);
+    dst[2] = make_line(x+w-size, y-h+size, w, size, 180, color);
+    dst[3] = make_line(x, y-h+size, h, size, 90, color);
+}
+
+void VulkanScene::index(ShapeHandle handle)
+{
+    Shape& shape = m_shapes[handle];
+    if(shape.indexed) m_grid.Remove(handle, shape.bounds);
+
+    shape.bounds = quad_bounds(m_instances[shape.first]);
+    for(uint32_t i = shape.first + 1; i < shape.first + shape.count; i++)
+    {
+        Bounds quad = quad_bounds(m_instances[i]);
+        shape.bounds.min_x = std::min(shape.bounds.min_x, quad.min_x);
+        shape.bounds.min_y = std::min(shape.bounds.min_y, quad.min_y);
+        shape.bounds.max_x = std::max(shape.bounds.max_x, quad.max_x);
+        shape.bounds.max_y = std::max(shape.bounds.max_y, quad.max_y);
+    }
+    m_grid.Insert(handle, shape.bounds);
+    shape.indexed = true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "build_order.hpp"
+#include "device.hpp"
+#include "quad_batch.hpp"
+#include "spatial_grid.hpp"
+
+// stable for the lifetime of the shape, reused only after Remove()
+typedef uint32_t ShapeHandle;
+static const ShapeHandle INVALID_SHAPE = UINT32_MAX;
+
+// retained set of lines and boxes backed by one instance buffer per frame in
+// flight. every shape owns a fixed range of instance slots, edits only mark the
+// shape dirty and Update() re-expands the dirty shapes and copies just their slots
+// into the frame's buffer, the other frames pick the same slots up on their turn.
+// with a view set, Cull() copies only the shapes a spatial grid finds inside
+// it into a per frame buffer, so the cost follows what is on screen
+class VulkanScene
+{
+public:
+    VulkanScene(VulkanDevice*, uint32_t capacity=1 << 20, uint32_t frame_count=2); // in quads, a box takes 4
+    ~VulkanScene();
+
+    // angles in degrees, like draw_line and draw_box
+    ShapeHandle AddLine(float x, float y, float length, float size=2, float angle=0, glm::vec3 color={1.0f, 0.0f, 1.0f});
+    ShapeHandle AddBox(float x, float y, float w, float h, float size=2, glm::vec3 color={1.0f, 0.0f, 1.0f});
+    void SetLine(ShapeHandle, float x, float y, float length, float size=2, float angle=0);
+    void SetBox(ShapeHandle, float x, float y, float w, float h, float size=2);
+    void SetColor(ShapeHandle, glm::vec3);
+    void Remove(ShapeHandle);
+
+    bool IsDirty(); // edits not yet expanded by Update()
+    // records the copies of every range the frame's instance buffer is missing into
+    // the staging ring and flushes it. the frame's previous submission must be complete
+    UploadTicket Update(uint32_t frame);
+
+    // pixels, shapes outside are skipped by Cull(). without a view everything is drawn
+    void SetView(const Bounds&);
+    void ClearView();
+    // fills the frame's visible buffer and points the quad batch at it, the frame's
+    // previous submission must be complete. returns the number of visible shapes
+    uint32_t Cull(uint32_t frame);
+
+    uint32_t GetShapeCount();
+    VulkanQuadBatch* GetQuadBatch(uint32_t frame);
+
+private:
+    enum class ShapeType { Line, Box };
+
+    struct Shape {
+        ShapeType type;
+        float x, y;
+        float width;  // length for lines
+        float height;
+        float size;
+        float angle;  // lines only, degrees
+        glm::vec3 color;
+        uint32_t first=0; // instance slot
+        uint32_t count=0;
+        Bounds bounds;    // as inserted into the grid
+        bool indexed=false;
+        bool alive=false;
+        bool dirty=false;
+    };
+
+    VulkanDevice* m_device;
+    std::vector<VulkanQuadBatch*> m_batches; // per frame
+    std::vector<std::vector<UploadRange>> m_pending; // per frame, slots its buffer is missing
+
+    std::vector<Shape> m_shapes;
+    std::vector<ShapeHandle> m_free_handles;
+    std::vector<ShapeHandle> m_dirty;
+    std::vector<UploadRange> m_removed; // zeroed slots still to be copied
+    uint32_t m_shape_count=0;
+
+    // mirrors the instance buffer, slots [0, m_slot_end) are drawn
+    std::vector<QuadInstance> m_instances;
+    uint32_t m_slot_end=0;
+    std::map<uint32_t, std::vector<uint32_t>> m_free_slots; // slot count -> first slots
+
+    SpatialGrid m_grid;
+    bool m_has_view=false;
+    Bounds m_view;
+    std::vector<uint32_t> m_visible;
+    uint32_t m_frame_count;
+    VkBuffer m_visible_buffer=VK_NULL_HANDLE; // capacity quads per frame, host visible
+    MemoryAllocation m_visible_memory;
+
+    ShapeHandle add(const Shape&);
+    Shape* get(ShapeHandle);
+    void markDirty(ShapeHandle);
+    void expand(const Shape&);
+    void index(ShapeHandle);
+};
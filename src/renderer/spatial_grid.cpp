@@ -0,0 +1,130 @@
+#include "spatial_grid.hpp"
+
+SpatialGrid::SpatialGrid(float cell_size)
+{
+    m_cell_size = cell_size;
+}
+
+void SpatialGrid::Insert(uint32_t item, const Bounds& bounds)
+{
+    if(item >= m_stamps.size()) m_stamps.resize(item + 1, 0);
+
+    // huge or degenerate bounds would fill a cell per grid step
+    if(cellCount(bounds) > MAX_ITEM_CELLS) {
+        m_oversize.push_back({item, bounds});
+        return;
+    }
+
+    for(int32_t y = cell(bounds.min_y); y <= cell(bounds.max_y); y++) {
+        for(int32_t x = cell(bounds.min_x); x <= cell(bounds.max_x); x++) {
+            m_cells[key(x, y)].push_back({item, bounds});
+        }
+    }
+}
+
+void SpatialGrid::Remove(uint32_t item, const Bounds& bounds)
+{
+    if(cellCount(bounds) > MAX_ITEM_CELLS)
+    {
+        for(size_t i = 0; i < m_oversize.size(); i++)
+        {
+            if(m_oversize[i].item != item) continue;
+            m_oversize[i] = m_oversize.back();
+            m_oversize.pop_back();
+            break;
+        }
+        return;
+    }
+
+    for(int32_t y = cell(bounds.min_y); y <= cell(bounds.max_y); y++)
+    {
+        for(int32_t x = cell(bounds.min_x); x <= cell(bounds.max_x); x++)
+        {
+            auto it = m_cells.find(key(x, y));
+            if(it == m_cells.end()) continue;
+
+            // order inside a cell does not matter
+            std::vector<Entry>& entries = it->second;
+            for(size_t i = 0; i < entries.size(); i++)
+            {
+                if(entries[i].item != item) continue;
+                entries[i] = entries.back();
+                entries.pop_back();
+                break;
+            }
+            if(entries.empty()) m_cells.erase(it);
+        }
+    }
+}
+
+void SpatialGrid::Query(const Bounds& view, std::vector<uint32_t>& items)
+{
+    // wrapped stamps could alias an old query
+    if(++m_stamp == 0) {
+        std::fill(m_stamps.begin(), m_stamps.end(), 0);
+        m_stamp = 1;
+    }
+
+    queryCell(m_oversize, view, items);
+
+    int64_t min_x = cell(view.min_x), max_x = cell(view.max_x);
+    int64_t min_y = cell(view.min_y), max_y = cell(view.max_y);
+    uint64_t view_cells = static_cast<uint64_t>(max_x - min_x + 1) * static_cast<uint64_t>(max_y - min_y + 1);
+
+    // zoomed far out the view covers more cells than are occupied
+    if(view_cells > m_cells.size())
+    {
+        for(auto& cell_entries : m_cells) queryCell(cell_entries.second, view, items);
+        return;
+    }
+
+    for(int64_t y = min_y; y <= max_y; y++)
+    {
+        for(int64_t x = min_x; x <= max_x; x++)
+        {
+            auto it = m_cells.find(key(static_cast<int32_t>(x), static_cast<int32_t>(y)));
+            if(it != m_cells.end()) queryCell(it->second, view, items);
+        }
+    }
+}
+
+void SpatialGrid::Clear()
+{
+    m_cells.clear();
+    m_oversize.clear();
+    m_stamps.clear();
+    m_stamp = 0;
+}
+
+int32_t SpatialGrid::cell(float value)
+{
+    float index = std::floor(value / m_cell_size);
+    if(std::isnan(index)) return 0;
+    return static_cast<int32_t>(std::min(std::max(index, -1073741824.0f), 1073741824.0f));
+}
+
+uint64_t SpatialGrid::cellCount(const Bounds& bounds)
+{
+    // nan bounds never overlap anything, they are kept out of the cells too
+    if(std::isnan(bounds.min_x) || std::isnan(bounds.max_x) || std::isnan(bounds.min_y) || std::isnan(bounds.max_y)) {
+        return UINT64_MAX;
+    }
+    int64_t columns = std::max<int64_t>(0, static_cast<int64_t>(cell(bounds.max_x)) - cell(bounds.min_x) + 1);
+    int64_t rows = std::max<int64_t>(0, static_cast<int64_t>(cell(bounds.max_y)) - cell(bounds.min_y) + 1);
+    return static_cast<uint64_t>(columns) * static_cast<uint64_t>(rows);
+}
+
+uint64_t SpatialGrid::key(int32_t x, int32_t y)
+{
+    return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y);
+}
+
+void SpatialGrid::queryCell(const std::vector<Entry>& entries, const Bounds& view, std::vector<uint32_t>& items)
+{
+    for(const Entry& entry : entries)
+    {
+        if(m_stamps[entry.item] == m_stamp || !entry.bounds.Overlaps(view)) continue;
+        m_stamps[entry.item] = m_stamp;
+        items.push_back(entry.item);
+    }
+}
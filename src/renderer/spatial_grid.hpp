@@ -0,0 +1,49 @@
+#pragma once
+
+#include "build_order.hpp"
+#include <unordered_map>
+
+// axis aligned box in pixels
+struct Bounds {
+    float min_x, min_y;
+    float max_x, max_y;
+
+    bool Overlaps(const Bounds& other) const
+    {
+        return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+    }
+};
+
+// uniform grid over item bounds, an item is listed in every cell it touches.
+// only occupied cells are stored so the document can be any size. items
+// spanning more than MAX_ITEM_CELLS cells are kept in one list every query checks
+class SpatialGrid
+{
+public:
+    static const uint64_t MAX_ITEM_CELLS = 64;
+
+    SpatialGrid(float cell_size=256.0f);
+
+    void Insert(uint32_t item, const Bounds&);
+    void Remove(uint32_t item, const Bounds&); // same bounds it was inserted with
+    // appends every item whose bounds overlap the view once, in no particular order
+    void Query(const Bounds& view, std::vector<uint32_t>& items);
+    void Clear();
+
+private:
+    struct Entry {
+        uint32_t item;
+        Bounds bounds;
+    };
+
+    float m_cell_size;
+    std::unordered_map<uint64_t, std::vector<Entry>> m_cells;
+    std::vector<Entry> m_oversize;
+    std::vector<uint32_t> m_stamps; // per item, dedups items spanning several cells
+    uint32_t m_stamp=0;
+
+    int32_t cell(float);
+    uint64_t cellCount(const Bounds&);
+    uint64_t key(int32_t, int32_t);
+    void queryCell(const std::vector<Entry>&, const Bounds&, std::vector<uint32_t>&);
+};
@@ -1,88 +1,198 @@
 #include "vertex_buffer.hpp"
 
 
-VulkanVertexBuffer::VulkanVertexBuffer(VulkanDevice* device, std::vector<Vertex> verts, std::vector<uint16_t> indices)
+VulkanVertexBuffer::VulkanVertexBuffer(
+        VulkanDevice* device, const Vertex* verts, size_t vert_count,
+        const uint32_t* indices, size_t index_count, VertexFormat format
+    )
 {
     m_device = device;
-    m_verts = verts;
-    m_indices = indices;
+    m_format = format;
 
-    createVertexBuffer(verts, &m_vertex_buffer, &m_vertex_buffer_memory);
-    createIndexBuffer(indices, &m_index_buffer, &m_index_buffer_memory);
+    createVertexBuffer(vert_count, [verts](Vertex* dst, size_t first, size_t count) {
+        memcpy(dst, verts + first, sizeof(Vertex) * count);
+    }, &m_vertex_buffer, &m_vertex_buffer_memory);
+    createIndexBuffer(indices, index_count, &m_index_buffer, &m_index_buffer_memory);
+    m_device->GetStagingRing()->Flush();
+}
+
+VulkanVertexBuffer::VulkanVertexBuffer(VulkanDevice* device, const Vertex* verts, size_t vert_count, VertexFormat format)
+    : VulkanVertexBuffer(device, vert_count, [verts](Vertex* dst, size_t first, size_t count) {
+        memcpy(dst, verts + first, sizeof(Vertex) * count);
+    }, format)
+{
+}
+
+VulkanVertexBuffer::VulkanVertexBuffer(VulkanDevice* device, size_t vert_count, const VertexWriter& writer, VertexFormat format)
+{
+    m_device = device;
+    m_format = format;
+
+    if(vert_count % 4 != 0) {
+        printfw("Quad list has %d vertices, the last quad is dropped\n", vert_count);
+    }
+    createVertexBuffer(vert_count, writer, &m_vertex_buffer, &m_vertex_buffer_memory);
+    createQuadRanges();
+    m_device->GetStagingRing()->Flush();
 }
 
 VulkanVertexBuffer::~VulkanVertexBuffer()
 {
-    printfi("-- Destroying Index Buffer...\n");
-    vkDestroyBuffer(m_device->GetDevice(), m_index_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), m_index_buffer_memory, nullptr);
+    if(m_index_buffer_memory.block != nullptr) {
+        printfi("-- Destroying Index Buffer...\n");
+        m_device->DestroyBuffer(m_index_buffer, m_index_buffer_memory);
+    }
 
     printfi("-- Destorying Vertex Buffer...\n");
-    vkDestroyBuffer(m_device->GetDevice(), m_vertex_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), m_vertex_buffer_memory, nullptr);
+    m_device->DestroyBuffer(m_vertex_buffer, m_vertex_buffer_memory);
 }
 
 VulkanDevice* VulkanVertexBuffer::GetVulkanDevice() { return m_device; }
 VkBuffer VulkanVertexBuffer::GetVertexBuffer() { return m_vertex_buffer; }
-VkDeviceMemory VulkanVertexBuffer::GetVertexBufferMemory() { return m_vertex_buffer_memory; }
+VkDeviceMemory VulkanVertexBuffer::GetVertexBufferMemory() { return m_vertex_buffer_memory.memory; }
 
 VkBuffer VulkanVertexBuffer::GetIndexBuffer() { return m_index_buffer;}
-VkDeviceMemory VulkanVertexBuffer::GetIndexDeviceMemory() { return m_index_buffer_memory;}
+VkDeviceMemory VulkanVertexBuffer::GetIndexDeviceMemory() { return m_index_buffer_memory.memory;}
+
+size_t VulkanVertexBuffer::GetVertexCount() { return m_vertex_count; }
+size_t VulkanVertexBuffer::GetIndexCount() { return m_index_count; }
+VertexFormat VulkanVertexBuffer::GetFormat() { return m_format; }
+VkIndexType VulkanVertexBuffer::GetIndexType() { return m_index_type; }
+const std::vector<DrawRange>& VulkanVertexBuffer::GetDrawRanges() { return m_draw_ranges; }
 
-std::vector<Vertex> VulkanVertexBuffer::GetVerts() { return m_verts; }
-std::vector<uint16_t> VulkanVertexBuffer::GetIndices() { return m_indices; }
+void VulkanVertexBuffer::createQuadRanges()
+{
+    uint32_t quad_count = static_cast<uint32_t>(m_vertex_count / 4);
+    for(uint32_t first = 0; first < quad_count; first += MAX_QUADS_PER_DRAW) {
+        uint32_t count = std::min(MAX_QUADS_PER_DRAW, quad_count - first);
+        m_draw_ranges.push_back({0, count * 6, static_cast<int32_t>(first * 4)});
+    }
+    m_index_buffer = m_device->GetQuadIndexBuffer();
+}
 
 void VulkanVertexBuffer::createVertexBuffer(
-        std::vector<Vertex> vect, VkBuffer* buffer, 
-        VkDeviceMemory* buffer_memory
+        size_t count, const VertexWriter& writer, VkBuffer* buffer, 
+        MemoryAllocation* buffer_memory
     ) 
 {
-    printfi("Creating Vertex Buffer of size %d...\n", vect.size());
-
-    VkDeviceSize size = sizeof(vect[0]) * vect.size();
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    printfi("Creating Vertex Buffer of size %d...\n", count);
+    m_vertex_count = count;
 
+    size_t stride = (m_format == VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex);
     m_device->CreateBuffer(
-        size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging_buffer, &staging_buffer_memory, vect.data()
-    );
-
-    m_device->CreateBuffer(
-        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        stride * count, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory
     );
 
-    m_device->CopyBuffer(staging_buffer, *buffer, size);
-
-    vkDestroyBuffer(m_device->GetDevice(), staging_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), staging_buffer_memory, nullptr);
+    VulkanStagingRing* ring = m_device->GetStagingRing();
+    if(m_format == VertexFormat::Standard) {
+        ring->UploadElements<Vertex>(*buffer, count, writer);
+        return;
+    }
+
+    // packed vertices go through a small scratch block instead of a full size copy
+    ring->UploadElements<PackedVertex>(*buffer, count, [&writer](PackedVertex* dst, size_t first, size_t n) {
+        Vertex scratch[256];
+        for(size_t done = 0; done < n; done += 256)
+        {
+            size_t batch = std::min<size_t>(256, n - done);
+            writer(scratch, first + done, batch);
+            for(size_t i = 0; i < batch; i++) dst[done + i] = PackedVertex::Pack(scratch[i]);
+        }
+    });
 }
 
-void VulkanVertexBuffer::createIndexBuffer(std::vector<uint16_t> vect, VkBuffer* buffer, VkDeviceMemory* buffer_memory) 
-{
-    printfi("Creating Index Buffer of size %d...\n", vect.size());
-
-    VkDeviceSize size = sizeof(vect[0]) * vect.size();
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    m_device->CreateBuffer(
-        size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging_buffer, &staging_buffer_memory, vect.data()
-    );
+// past this many split draws a single 32 bit draw is cheaper than the extra commands
+static const size_t MAX_SPLIT_DRAWS = 16;
 
+void VulkanVertexBuffer::createIndexBuffer(const uint32_t* indices, size_t count, VkBuffer* buffer, MemoryAllocation* buffer_memory) 
+{
+    printfi("Creating Index Buffer of size %d...\n", count);
+    m_index_count = count;
+
+    uint32_t max_index = 0;
+    for(size_t i = 0; i < count; i++) max_index = std::max(max_index, indices[i]);
+
+    // split the triangle list wherever a range would span more than 16 bits
+    m_draw_ranges.clear();
+    bool wide_triangle = false; // one triangle alone spans more than 16 bits
+    if(max_index <= UINT16_MAX) {
+        m_draw_ranges.push_back({0, static_cast<uint32_t>(count), 0});
+    } 
+    else 
+    {
+        if(count % 3 != 0) {
+            printfw("Index count %d is not a triangle list\n", count);
+        }
+
+        DrawRange range = {0, 0, 0};
+        uint32_t range_min = UINT32_MAX, range_max = 0;
+        for(size_t i = 0; i + 3 <= count; i += 3)
+        {
+            uint32_t tri_min = std::min({indices[i], indices[i + 1], indices[i + 2]});
+            uint32_t tri_max = std::max({indices[i], indices[i + 1], indices[i + 2]});
+            if(tri_max - tri_min > UINT16_MAX) wide_triangle = true;
+            uint32_t new_min = std::min(range_min, tri_min);
+            uint32_t new_max = std::max(range_max, tri_max);
+            if(range.index_count > 0 && new_max - new_min > UINT16_MAX) {
+                range.vertex_offset = static_cast<int32_t>(range_min);
+                m_draw_ranges.push_back(range);
+                range = {static_cast<uint32_t>(i), 0, 0};
+                new_min = tri_min;
+                new_max = tri_max;
+            }
+            range_min = new_min;
+            range_max = new_max;
+            range.index_count += 3;
+        }
+        if(range.index_count > 0) {
+            range.vertex_offset = static_cast<int32_t>(range_min);
+            m_draw_ranges.push_back(range);
+        }
+    }
+
+    // no split keeps a wide triangle in 16 bits, it needs the 32 bit indices
+    uint32_t max_index_value = m_device->GetPhysicalDevice()->GetProperties().limits.maxDrawIndexedIndexValue;
+    if(wide_triangle && max_index > max_index_value) {
+        printff("Index %u is above maxDrawIndexedIndexValue %u and can not be split into 16 bit draws\n", max_index, max_index_value);
+    }
+    bool use_uint32 = wide_triangle || (m_draw_ranges.size() > MAX_SPLIT_DRAWS && max_index <= max_index_value);
+    if(use_uint32) 
+    {
+        m_index_type = VK_INDEX_TYPE_UINT32;
+        m_draw_ranges.clear();
+        m_draw_ranges.push_back({0, static_cast<uint32_t>(count), 0});
+    } 
+    else 
+    {
+        m_index_type = VK_INDEX_TYPE_UINT16;
+    }
+    if(m_draw_ranges.size() > 1) {
+        printfi("Index buffer split into %d 16 bit draws\n", m_draw_ranges.size());
+    }
+
+    size_t index_size = use_uint32 ? sizeof(uint32_t) : sizeof(uint16_t);
     m_device->CreateBuffer(
-        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        index_size * count, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory
     );
 
-    m_device->CopyBuffer(staging_buffer, *buffer, size);
-
-    vkDestroyBuffer(m_device->GetDevice(), staging_buffer, nullptr);
-    vkFreeMemory(m_device->GetDevice(), staging_buffer_memory, nullptr);
+    VulkanStagingRing* ring = m_device->GetStagingRing();
+    if(use_uint32) {
+        ring->UploadElements<uint32_t>(*buffer, count, [indices](uint32_t* dst, size_t first, size_t n) {
+            memcpy(dst, indices + first, sizeof(uint32_t) * n);
+        });
+        return;
+    }
+
+    // narrowed chunk by chunk, rebased on the range each index belongs to
+    const std::vector<DrawRange>& ranges = m_draw_ranges;
+    ring->UploadElements<uint16_t>(*buffer, count, [indices, &ranges](uint16_t* dst, size_t first, size_t n) {
+        size_t r = 0;
+        for(size_t i = first; i < first + n; i++)
+        {
+            while(r + 1 < ranges.size() && i >= ranges[r + 1].first_index) r++;
+            dst[i - first] = static_cast<uint16_t>(indices[i] - static_cast<uint32_t>(ranges[r].vertex_offset));
+        }
+    });
 }
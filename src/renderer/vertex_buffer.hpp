@@ -1,7 +1,9 @@
 #pragma once
 
 #include "build_order.hpp"
+#include <functional>
 #include "device.hpp"
+#include "memory_allocator.hpp"
 struct Vertex {
     glm::vec4 pos;
     glm::vec3 color;
@@ -37,12 +39,86 @@ struct Vertex {
     }
 };
 
+enum class VertexFormat {
+    Standard, // Vertex, 36 bytes
+    Packed    // PackedVertex, 8 bytes
+};
+
+// quantized Vertex for large scenes, positions are pixels in 14.2 fixed point
+// (+-8191.75, enough for a 300 dpi A4 page) and colors are RGBA8. uvs are not
+// carried, like the standard format no shader reads them yet
+struct PackedVertex {
+    int16_t pos[2];
+    uint32_t color;
+
+    static PackedVertex Pack(const Vertex& vertex)
+    {
+        auto to_fixed = [](float v) {
+            return static_cast<int16_t>(std::min(std::max(std::round(v * 4.0f), -32768.0f), 32767.0f));
+        };
+        auto to_byte = [](float v) {
+            return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+        };
+
+        PackedVertex packed;
+        packed.pos[0] = to_fixed(vertex.pos.x);
+        packed.pos[1] = to_fixed(vertex.pos.y);
+        packed.color = to_byte(vertex.color.x) | to_byte(vertex.color.y) << 8 | to_byte(vertex.color.z) << 16 | 255u << 24;
+        return packed;
+    }
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription binding_description;
+        binding_description.binding = 0;
+        binding_description.stride = sizeof(PackedVertex);
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return binding_description;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions;
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16_SINT;
+        attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, color);
+        return attributeDescriptions;
+    }
+};
+
+// one vkCmdDrawIndexed worth of the index buffer
+struct DrawRange {
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset; // added to every index, keeps 16 bit indices local to the range
+};
+
 class VulkanDevice;
 
+// indices are stored as uint16 whenever possible, either because they all fit
+// or by splitting the triangle list into ranges that each span < 65536 vertices.
+// without indices the vertices are a quad list drawn with the device's quad index buffer.
+// geometry is read from the caller's arrays straight into the staging ring and
+// nothing is kept on the cpu, so the arrays can be released once the constructor returns
 class VulkanVertexBuffer
 {
 public:
-    VulkanVertexBuffer(VulkanDevice* device, std::vector<Vertex>, std::vector<uint16_t>);
+    // writes vertices [first, first + count) to dst, which points into mapped staging memory
+    typedef std::function<void(Vertex* dst, size_t first, size_t count)> VertexWriter;
+
+    VulkanVertexBuffer(
+        VulkanDevice* device, const Vertex*, size_t, const uint32_t*, size_t,
+        VertexFormat format=VertexFormat::Standard
+    );
+    VulkanVertexBuffer(VulkanDevice* device, const Vertex*, size_t, VertexFormat format=VertexFormat::Standard);
+    // quad list generated directly into staging, e.g. with ExpandLines()
+    VulkanVertexBuffer(VulkanDevice* device, size_t, const VertexWriter&, VertexFormat format=VertexFormat::Standard);
     ~VulkanVertexBuffer();
     
     VulkanDevice* GetVulkanDevice();
@@ -50,17 +126,24 @@ public:
     VkDeviceMemory GetVertexBufferMemory();
     VkBuffer GetIndexBuffer();
     VkDeviceMemory GetIndexDeviceMemory();
-    std::vector<Vertex> GetVerts();
-    std::vector<uint16_t> GetIndices();
+    size_t GetVertexCount();
+    size_t GetIndexCount(); // 0 for quad lists
+    VertexFormat GetFormat();
+    VkIndexType GetIndexType();
+    const std::vector<DrawRange>& GetDrawRanges();
 private:
     VulkanDevice* m_device;
     VkBuffer m_vertex_buffer;
-    VkDeviceMemory m_vertex_buffer_memory;
-    VkBuffer m_index_buffer;
-    VkDeviceMemory m_index_buffer_memory;
-    std::vector<Vertex> m_verts;
-    std::vector<uint16_t> m_indices;
-
-    void createVertexBuffer(std::vector<Vertex>, VkBuffer*, VkDeviceMemory*);
-    void createIndexBuffer(std::vector<uint16_t>, VkBuffer*, VkDeviceMemory*);
+    MemoryAllocation m_vertex_buffer_memory;
+    VkBuffer m_index_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_index_buffer_memory; // empty when the shared quad indices are used
+    size_t m_vertex_count=0;
+    size_t m_index_count=0;
+    VertexFormat m_format;
+    VkIndexType m_index_type=VK_INDEX_TYPE_UINT16;
+    std::vector<DrawRange> m_draw_ranges;
+
+    void createVertexBuffer(size_t, const VertexWriter&, VkBuffer*, MemoryAllocation*);
+    void createIndexBuffer(const uint32_t*, size_t, VkBuffer*, MemoryAllocation*);
+    void createQuadRanges();
 };
@@ -8,7 +8,8 @@ VulkanDevice::VulkanDevice(VulkanInstance* instance, VulkanPhysicalDevice* physi
     uint32_t compute_index = m_physical_device->GetQueueFamily().compute_index;
     uint32_t graphics_index = m_physical_device->GetQueueFamily().graphics_index;
     uint32_t present_index = m_physical_device->GetQueueFamily().present_index;
-    std::set<uint32_t> unique_queue_indices = {compute_index, graphics_index};
+    uint32_t transfer_index = m_physical_device->GetQueueFamily().transfer_index;
+    std::set<uint32_t> unique_queue_indices = {compute_index, graphics_index, transfer_index};
     if(m_physical_device->HasSwapchainEnabled()) {
         unique_queue_indices.insert(present_index);
     }
@@ -67,15 +68,37 @@ VulkanDevice::VulkanDevice(VulkanInstance* instance, VulkanPhysicalDevice* physi
         printfw("Failed to find suitable presentation indices\n");
     }
 
-    createCommandPool(&m_ccompute_pool, compute_index, 0);
+    printfi("Creating transfer queue\n");
+    vkGetDeviceQueue(
+        m_device,
+        transfer_index,
+        0,
+        &m_transfer_queue
+    );
+
+    createCommandPool(&m_ccompute_pool, compute_index, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     createCommandPool(&m_cgraphics_pool, graphics_index, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    createCommandPool(&m_ctransfer_pool, transfer_index, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    m_allocator = new VulkanMemoryAllocator(m_device, m_physical_device);
+    m_staging_ring = new VulkanStagingRing(this);
+    createQuadIndexBuffer();
 }
 
 VulkanDevice::~VulkanDevice()
 {
+    if(m_staging_ring != nullptr) delete m_staging_ring;
+    if(m_quad_index_buffer != VK_NULL_HANDLE) DestroyBuffer(m_quad_index_buffer, m_quad_index_memory);
+
     printfi("-- Destroying Command Pools...\n");
     vkDestroyCommandPool(m_device, m_cgraphics_pool, nullptr);
     vkDestroyCommandPool(m_device, m_ccompute_pool, nullptr);
+    vkDestroyCommandPool(m_device, m_ctransfer_pool, nullptr);
+
+    if(m_allocator != nullptr) {
+        m_allocator->PrintStats();
+        delete m_allocator;
+    }
     
     printfi("-- Destroying Logcial Device...\n");
     vkDestroyDevice(m_device, nullptr);
@@ -87,8 +110,13 @@ VulkanInstance* VulkanDevice::GetInstance() { return m_instance; }
 VkQueue VulkanDevice::GetComputeQueue() { return m_compute_queue; }
 VkQueue VulkanDevice::GetGraphicsQueue() { return m_graphics_queue; }
 VkQueue VulkanDevice::GetPresentQueue() { return m_present_queue; }
+VkQueue VulkanDevice::GetTransferQueue() { return m_transfer_queue; }
 VkCommandPool& VulkanDevice::GetComputeCommandPool() { return m_ccompute_pool; }
 VkCommandPool& VulkanDevice::GetGraphicsCommandPool() { return m_cgraphics_pool; }
+VkCommandPool& VulkanDevice::GetTransferCommandPool() { return m_ctransfer_pool; }
+VulkanMemoryAllocator* VulkanDevice::GetAllocator() { return m_allocator; }
+VulkanStagingRing* VulkanDevice::GetStagingRing() { return m_staging_ring; }
+VkBuffer VulkanDevice::GetQuadIndexBuffer() { return m_quad_index_buffer; }
 
 void VulkanDevice::SetComputeCommand(VkCommandBuffer* buffers, uint32_t count)
 {
@@ -140,6 +168,7 @@ void VulkanDevice::EndSingleCommand(VkCommandBuffer command_buffer, uint32_t fla
 
     if(flag != 0) {
         SubmitWork(command_buffer, m_graphics_queue);
+        vkFreeCommandBuffers(m_device, m_cgraphics_pool, 1, &command_buffer);
         return;
     }
 
@@ -164,8 +193,9 @@ void VulkanDevice::CreateBuffer(
         VkBufferUsageFlags usage, 
         VkMemoryPropertyFlags properties, 
         VkBuffer* buffer, 
-        VkDeviceMemory* buffer_memory,
-        void* data
+        MemoryAllocation* allocation,
+        void* data,
+        AllocationStrategy strategy
     ) 
 {
     VkBufferCreateInfo buffer_info = init::buffer_info(size, usage);
@@ -184,57 +214,46 @@ void VulkanDevice::CreateBuffer(
         &mem_requirements
     );
 
-    VkMemoryAllocateInfo alloc_info = init::memory_allocate_info(
-        mem_requirements,
-        FindMemoryType(mem_requirements.memoryTypeBits, properties)
-    );
-
-    ErrorCheck(vkAllocateMemory(
-        m_device,
-        &alloc_info,
-        nullptr,
-        buffer_memory
-    ), "Allocate Buffer Memory");
+    *allocation = m_allocator->Allocate(mem_requirements, properties, strategy);
 
     if (data != nullptr) {
-        void *mapped;
-        ErrorCheck(vkMapMemory(
-            m_device, 
-            *buffer_memory, 
-            0, size, 0, 
-            &mapped
-        ), "Map Memory");
-        memcpy(mapped, data, size);
-        vkUnmapMemory(m_device, *buffer_memory);
+        if(allocation->mapped == nullptr) {
+            printff("Can not copy data into a buffer that is not host visible\n");
+        }
+        memcpy(allocation->mapped, data, size);
     }
 
     ErrorCheck(vkBindBufferMemory(
         m_device,
         *buffer,
-        *buffer_memory,
-        0
+        allocation->memory,
+        allocation->offset
     ), "Bind Buffer Memory");
 }
 
-void VulkanDevice::CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) 
+void VulkanDevice::DestroyBuffer(VkBuffer buffer, MemoryAllocation& allocation)
+{
+    vkDestroyBuffer(m_device, buffer, nullptr);
+    m_allocator->Free(allocation);
+}
+
+// batched into the staging ring submission, returned ticket completes
+// once dst_buffer is owned by and visible to the graphics queue
+UploadTicket VulkanDevice::CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) 
 {
-    VkCommandBuffer command_buffer = BeginSingleCommand();
-    
     VkBufferCopy copy_region = {};
     copy_region.srcOffset = 0;
     copy_region.dstOffset = 0;
     copy_region.size = size;
-    vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-    EndSingleCommand(command_buffer, 1);
+    vkCmdCopyBuffer(m_staging_ring->GetCommandBuffer(), src_buffer, dst_buffer, 1, &copy_region);
 
-    vkFreeCommandBuffers(m_device, m_cgraphics_pool, 1, &command_buffer);
+    return m_staging_ring->TrackBuffer(dst_buffer, 0, size);
 }
 
 // using a fence to sync queue
 void VulkanDevice::SubmitWork(VkCommandBuffer cmd_buffer, VkQueue queue)
 {
-    if(m_graphics_queue == NULL) printff("graphics queue is not set!\n");
+    if(queue == NULL) printff("queue is not set!\n");
 
     VkSubmitInfo submit_info = init::submit_info(1, &cmd_buffer);
     VkFenceCreateInfo fence_info = init::fence_info();
@@ -245,7 +264,7 @@ void VulkanDevice::SubmitWork(VkCommandBuffer cmd_buffer, VkQueue queue)
         m_device, &fence_info, nullptr, &fence
     ), "Create Fence");
     ErrorCheck(vkQueueSubmit(
-        m_graphics_queue, 1, &submit_info, fence
+        queue, 1, &submit_info, fence
     ), "Queue Submit");
     ErrorCheck(vkWaitForFences(
         m_device, 1, &fence, VK_TRUE, UINT64_MAX
@@ -310,3 +329,27 @@ void VulkanDevice::createCommandPool(VkCommandPool* command_pool, uint32_t indic
     ), "Create Command Pool");
 }
 
+// every quad batch binds the same indices, so they are generated and uploaded once
+void VulkanDevice::createQuadIndexBuffer()
+{
+    std::vector<uint16_t> indices(MAX_QUADS_PER_DRAW * 6);
+    for(uint32_t quad = 0; quad < MAX_QUADS_PER_DRAW; quad++)
+    {
+        uint16_t tr = static_cast<uint16_t>(quad * 4);
+        uint16_t br = static_cast<uint16_t>(quad * 4 + 1);
+        uint16_t bl = static_cast<uint16_t>(quad * 4 + 2);
+        uint16_t tl = static_cast<uint16_t>(quad * 4 + 3);
+        const uint16_t pos[6] = {
+            tr, br, bl, bl, tl, tr
+        };
+        std::copy(pos, pos + 6, indices.begin() + quad * 6);
+    }
+
+    VkDeviceSize size = sizeof(uint16_t) * indices.size();
+    CreateBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_quad_index_buffer, &m_quad_index_memory
+    );
+    m_staging_ring->UploadBuffer(m_quad_index_buffer, indices.data(), size);
+    m_staging_ring->Flush();
+}
@@ -3,10 +3,14 @@
 #include "build_order.hpp"
 #include "instance.hpp"
 #include "physical_device.hpp"
-#include "pipeline.hpp"
+#include "memory_allocator.hpp"
+#include "staging_ring.hpp"
 
 class VulkanPhysicalDevice;
 
+// quads per draw the shared quad index buffer covers, 65536 vertices is all a 16 bit index reaches
+static const uint32_t MAX_QUADS_PER_DRAW = 16384;
+
 class VulkanDevice 
 {
 public:
@@ -19,14 +23,23 @@ public:
     VkQueue GetComputeQueue();
     VkQueue GetGraphicsQueue();
     VkQueue GetPresentQueue();
+    VkQueue GetTransferQueue();
     VkCommandPool& GetComputeCommandPool();
     VkCommandPool& GetGraphicsCommandPool();
+    VkCommandPool& GetTransferCommandPool();
     void SetComputeCommand(VkCommandBuffer*, uint32_t);
     void FreeComputeCommand(VkCommandBuffer*, uint32_t);
     VkCommandBuffer BeginSingleCommand(); // move this in VulkanDevice?
     void EndSingleCommand(VkCommandBuffer, uint32_t flag=0); 
-    void CreateBuffer(VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer*, VkDeviceMemory*, void* data=nullptr);
-    void CopyBuffer(VkBuffer, VkBuffer, VkDeviceSize);
+    VulkanMemoryAllocator* GetAllocator();
+    VulkanStagingRing* GetStagingRing();
+    VkBuffer GetQuadIndexBuffer(); // uint16, MAX_QUADS_PER_DRAW quads of tr, br, bl, bl, tl, tr
+    void CreateBuffer(
+        VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer*, MemoryAllocation*, void* data=nullptr,
+        AllocationStrategy strategy=AllocationStrategy::FreeList
+    );
+    void DestroyBuffer(VkBuffer, MemoryAllocation&);
+    UploadTicket CopyBuffer(VkBuffer, VkBuffer, VkDeviceSize);
     void SubmitWork(VkCommandBuffer, VkQueue);
     uint32_t FindMemoryType(uint32_t, VkMemoryPropertyFlags);
     bool GetSupportedDepthFormat(VkFormat* depthFormat);
@@ -35,10 +48,16 @@ private:
     VkQueue m_compute_queue=NULL;
     VkQueue m_graphics_queue=NULL;
     VkQueue m_present_queue=NULL;
+    VkQueue m_transfer_queue=NULL;
     VulkanInstance* m_instance;
     VulkanPhysicalDevice* m_physical_device=nullptr;
     VkCommandPool m_ccompute_pool;
     VkCommandPool m_cgraphics_pool;
+    VkCommandPool m_ctransfer_pool=VK_NULL_HANDLE;
+    VulkanMemoryAllocator* m_allocator=nullptr;
+    VulkanStagingRing* m_staging_ring=nullptr;
+    VkBuffer m_quad_index_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_quad_index_memory;
 
     void createFrameBuffers(
         std::vector<VkImageView>, 
@@ -46,5 +65,6 @@ private:
         uint32_t width, uint32_t height
     );
     void createCommandPool(VkCommandPool*, uint32_t, VkCommandPoolCreateFlags);
+    void createQuadIndexBuffer();
     
 };
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "memory_allocator.hpp"
+#include "physical_device.hpp"
+
+struct MemoryBlock {
+    VkDeviceMemory memory=VK_NULL_HANDLE;
+    VkDeviceSize size=0;
+    uint8_t* mapped=nullptr;
+    uint32_t memory_type=0;
+    AllocationStrategy strategy=AllocationStrategy::FreeList;
+    bool dedicated=false; // holds a single oversized allocation
+
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges; // offset -> size, free list only
+    VkDeviceSize head=0; // linear only
+    uint32_t allocations=0;
+    VkDeviceSize used=0;
+};
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    if(alignment <= 1) return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VkDevice device, VulkanPhysicalDevice* physical_device, VkDeviceSize block_size)
+{
+    m_device = device;
+    m_memory_properties = physical_device->GetMemoryProperties();
+    m_granularity = physical_device->GetProperties().limits.bufferImageGranularity;
+    m_atom_size = std::max<VkDeviceSize>(1, physical_device->GetProperties().limits.nonCoherentAtomSize);
+    m_block_size = block_size;
+    m_stats.max_device_allocations = physical_device->GetProperties().limits.maxMemoryAllocationCount;
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+    printfi("-- Destroying Memory Blocks...\n");
+    for(uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+        for(auto block : m_blocks[i])
+        {
+            if(block->allocations > 0) {
+                printfw("Memory block of type %d still has %d allocations\n", i, block->allocations);
+            }
+            destroyBlock(block);
+        }
+        m_blocks[i].clear();
+    }
+}
+
+MemoryAllocation VulkanMemoryAllocator::Allocate(
+        VkMemoryRequirements requirements, VkMemoryPropertyFlags properties,
+        AllocationStrategy strategy, bool optimal_image
+    )
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    VkDeviceSize alignment = requirements.alignment;
+    VkDeviceSize size = requirements.size;
+    // optimal images own whole granularity pages so they never alias a linear resource
+    if(optimal_image) {
+        alignment = std::max(alignment, m_granularity);
+        size = align_up(size, m_granularity);
+    }
+
+    uint32_t memory_type = findMemoryType(requirements.memoryTypeBits, properties);
+
+    MemoryBlock* block = nullptr;
+    VkDeviceSize offset = 0;
+    for(auto b : m_blocks[memory_type])
+    {
+        if(b->dedicated || b->strategy != strategy) continue;
+        if(allocateFromBlock(b, size, alignment, &offset)) {
+            block = b;
+            break;
+        }
+    }
+
+    if(block == nullptr)
+    {
+        bool dedicated = size > m_block_size;
+        block = createBlock(memory_type, dedicated ? size : m_block_size, strategy, dedicated);
+        if(!allocateFromBlock(block, size, alignment, &offset)) {
+            printff("Failed to sub allocate %llu bytes from a new memory block\n", (unsigned long long) size);
+        }
+    }
+
+    block->allocations++;
+    block->used += size;
+    m_stats.types[memory_type].allocations++;
+    m_stats.types[memory_type].used += size;
+    m_stats.total_sub_allocations++;
+
+    MemoryAllocation allocation;
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.mapped = (block->mapped != nullptr) ? block->mapped + offset : nullptr;
+    allocation.block = block;
+    return allocation;
+}
+
+void VulkanMemoryAllocator::Free(MemoryAllocation& allocation)
+{
+    if(allocation.block == nullptr) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryBlock* block = allocation.block;
+    block->allocations--;
+    block->used -= allocation.size;
+    m_stats.types[block->memory_type].allocations--;
+    m_stats.types[block->memory_type].used -= allocation.size;
+
+    if(block->strategy == AllocationStrategy::FreeList)
+    {
+        // put the range back and merge it with its neighbours
+        auto it = block->free_ranges.emplace(allocation.offset, allocation.size).first;
+        auto next = std::next(it);
+        if(next != block->free_ranges.end() && it->first + it->second == next->first) {
+            it->second += next->second;
+            block->free_ranges.erase(next);
+        }
+        if(it != block->free_ranges.begin()) {
+            auto prev = std::prev(it);
+            if(prev->first + prev->second == it->first) {
+                prev->second += it->second;
+                block->free_ranges.erase(it);
+            }
+        }
+    }
+    else if(block->allocations == 0)
+    {
+        block->head = 0;
+    }
+
+    // oversized blocks are not worth keeping around
+    if(block->dedicated && block->allocations == 0)
+    {
+        auto& blocks = m_blocks[block->memory_type];
+        blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+        destroyBlock(block);
+    }
+
+    allocation = MemoryAllocation();
+}
+
+void VulkanMemoryAllocator::Invalidate(const MemoryAllocation& allocation)
+{
+    MemoryBlock* block = allocation.block;
+    if(block == nullptr || block->mapped == nullptr) return;
+    if(m_memory_properties.memoryTypes[block->memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+
+    // the range has to cover whole atoms, or run to the end of the block
+    VkDeviceSize offset = allocation.offset / m_atom_size * m_atom_size;
+    VkDeviceSize end = align_up(allocation.offset + allocation.size, m_atom_size);
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = block->memory;
+    range.offset = offset;
+    range.size = (end >= block->size) ? VK_WHOLE_SIZE : end - offset;
+    ErrorCheck(vkInvalidateMappedMemoryRanges(m_device, 1, &range), "Invalidate Mapped Memory");
+}
+
+MemoryStats VulkanMemoryAllocator::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void VulkanMemoryAllocator::PrintStats()
+{
+    MemoryStats stats = GetStats();
+
+    printfi("------------------ Memory Statistics ------------------\n");
+    printfi("device allocations: %u / %u (total %llu)\n",
+        stats.device_allocations, stats.max_device_allocations,
+        (unsigned long long) stats.total_device_allocations
+    );
+    printfi("sub allocations: %llu, peak reserved: %.2f MiB\n",
+        (unsigned long long) stats.total_sub_allocations, stats.peak_reserved / (1024.0 * 1024.0)
+    );
+    for(uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+    {
+        const MemoryTypeStats& type = stats.types[i];
+        if(type.blocks == 0) continue;
+        printfi("type %u (flags 0x%x): %u blocks, %u allocations, %.2f / %.2f MiB used\n",
+            i, m_memory_properties.memoryTypes[i].propertyFlags, type.blocks, type.allocations,
+            type.used / (1024.0 * 1024.0), type.reserved / (1024.0 * 1024.0)
+        );
+    }
+    printfi("------------------------------------------------------\n");
+}
+
+uint32_t VulkanMemoryAllocator::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties)
+{
+    for(uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++)
+    {
+        if(type_filter & (1 << i) && (m_memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    printff("Failed to find suitable memory type!\n");
+    return 0;
+}
+
+MemoryBlock* VulkanMemoryAllocator::createBlock(uint32_t memory_type, VkDeviceSize size, AllocationStrategy strategy, bool dedicated)
+{
+    MemoryBlock* block = new MemoryBlock();
+    block->size = size;
+    block->memory_type = memory_type;
+    block->strategy = strategy;
+    block->dedicated = dedicated;
+    if(strategy == AllocationStrategy::FreeList) {
+        block->free_ranges[0] = size;
+    }
+
+    VkMemoryRequirements requirements = {};
+    requirements.size = size;
+    VkMemoryAllocateInfo alloc_info = init::memory_allocate_info(requirements, memory_type);
+
+    ErrorCheck(vkAllocateMemory(
+        m_device,
+        &alloc_info,
+        nullptr,
+        &block->memory
+    ), "Allocate Memory Block");
+
+    // host visible blocks stay mapped for their whole lifetime
+    if(m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        ErrorCheck(vkMapMemory(
+            m_device, block->memory,
+            0, VK_WHOLE_SIZE, 0,
+            (void**)&block->mapped
+        ), "Map Memory Block");
+    }
+
+    m_blocks[memory_type].push_back(block);
+
+    m_stats.device_allocations++;
+    m_stats.total_device_allocations++;
+    m_stats.types[memory_type].blocks++;
+    m_stats.types[memory_type].reserved += size;
+
+    VkDeviceSize reserved = 0;
+    for(auto& type : m_stats.types) reserved += type.reserved;
+    m_stats.peak_reserved = std::max(m_stats.peak_reserved, reserved);
+
+    return block;
+}
+
+void VulkanMemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+    if(block->mapped != nullptr) {
+        vkUnmapMemory(m_device, block->memory);
+    }
+    vkFreeMemory(m_device, block->memory, nullptr);
+
+    m_stats.device_allocations--;
+    m_stats.types[block->memory_type].blocks--;
+    m_stats.types[block->memory_type].reserved -= block->size;
+
+    delete block;
+}
+
+bool VulkanMemoryAllocator::allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+    if(block->strategy == AllocationStrategy::Linear)
+    {
+        VkDeviceSize aligned = align_up(block->head, alignment);
+        if(aligned + size > block->size) return false;
+        block->head = aligned + size;
+        *offset = aligned;
+        return true;
+    }
+
+    // first fit
+    for(auto it = block->free_ranges.begin(); it != block->free_ranges.end(); it++)
+    {
+        VkDeviceSize range_offset = it->first;
+        VkDeviceSize range_size = it->second;
+        VkDeviceSize aligned = align_up(range_offset, alignment);
+        if(aligned + size > range_offset + range_size) continue;
+
+        block->free_ranges.erase(it);
+        if(aligned > range_offset) {
+            block->free_ranges[range_offset] = aligned - range_offset;
+        }
+        if(aligned + size < range_offset + range_size) {
+            block->free_ranges[aligned + size] = range_offset + range_size - (aligned + size);
+        }
+        *offset = aligned;
+        return true;
+    }
+
+    return false;
+}
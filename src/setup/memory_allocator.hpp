@@ -0,0 +1,71 @@
+#pragma once
+
+#include "build_order.hpp"
+#include <mutex>
+
+class VulkanPhysicalDevice;
+
+enum class AllocationStrategy {
+    FreeList, // long lived resources, freed ranges are reused
+    Linear    // short lived resources, block is recycled once everything in it is freed
+};
+
+struct MemoryBlock;
+
+struct MemoryAllocation {
+    VkDeviceMemory memory=VK_NULL_HANDLE;
+    VkDeviceSize offset=0;
+    VkDeviceSize size=0;
+    void* mapped=nullptr; // already offset, only set for host visible memory
+    MemoryBlock* block=nullptr;
+};
+
+struct MemoryTypeStats {
+    uint32_t blocks=0;
+    uint32_t allocations=0;
+    VkDeviceSize reserved=0; // bytes allocated from the driver
+    VkDeviceSize used=0;     // bytes handed out to resources
+};
+
+struct MemoryStats {
+    uint32_t device_allocations=0;     // live vkAllocateMemory allocations
+    uint32_t max_device_allocations=0; // maxMemoryAllocationCount
+    uint64_t total_device_allocations=0;
+    uint64_t total_sub_allocations=0;
+    VkDeviceSize peak_reserved=0;
+    std::array<MemoryTypeStats, VK_MAX_MEMORY_TYPES> types;
+};
+
+// hands out ranges of large VkDeviceMemory blocks, one set of blocks per memory type
+class VulkanMemoryAllocator
+{
+public:
+    VulkanMemoryAllocator(VkDevice, VulkanPhysicalDevice*, VkDeviceSize block_size=64*1024*1024);
+    ~VulkanMemoryAllocator();
+
+    MemoryAllocation Allocate(
+        VkMemoryRequirements, VkMemoryPropertyFlags,
+        AllocationStrategy strategy=AllocationStrategy::FreeList,
+        bool optimal_image=false
+    );
+    void Free(MemoryAllocation&);
+    // makes device writes to a mapped allocation visible to the host, nothing to do for coherent memory
+    void Invalidate(const MemoryAllocation&);
+    MemoryStats GetStats();
+    void PrintStats();
+
+private:
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memory_properties;
+    VkDeviceSize m_granularity;
+    VkDeviceSize m_atom_size; // nonCoherentAtomSize
+    VkDeviceSize m_block_size;
+    std::vector<MemoryBlock*> m_blocks[VK_MAX_MEMORY_TYPES];
+    MemoryStats m_stats;
+    std::mutex m_mutex;
+
+    uint32_t findMemoryType(uint32_t, VkMemoryPropertyFlags);
+    MemoryBlock* createBlock(uint32_t, VkDeviceSize, AllocationStrategy, bool);
+    void destroyBlock(MemoryBlock*);
+    bool allocateFromBlock(MemoryBlock*, VkDeviceSize, VkDeviceSize, VkDeviceSize*);
+};
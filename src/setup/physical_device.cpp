@@ -95,6 +95,7 @@ VulkanPhysicalDevice* VulkanPhysicalDevice::GetPhysicalDevice(VulkanInstance* in
 
 VkPhysicalDevice& VulkanPhysicalDevice::GetDevice() { return m_device; }
 QueueFamilyIndices& VulkanPhysicalDevice::GetQueueFamily() { return m_queue_family; }
+VkPhysicalDeviceProperties& VulkanPhysicalDevice::GetProperties() { return m_properties; }
 VkPhysicalDeviceFeatures& VulkanPhysicalDevice::GetFeatures() { return m_features; }
 VkPhysicalDeviceMemoryProperties& VulkanPhysicalDevice::GetMemoryProperties() { return m_memory_properties; }
 bool VulkanPhysicalDevice::HasSwapchainEnabled() { return m_swapchain_needed; }
@@ -172,20 +173,37 @@ bool VulkanPhysicalDevice::hasSupportQueueFamily(VkPhysicalDevice* device, Queue
     ); 
     bool found_surface = true;
     if(surface != nullptr) found_surface = false;
+    bool found_compute_only = false;
+
     for(uint32_t i = 0; i < queue_families.size(); i++)
     {   
         VkQueueFamilyProperties qf = queue_families[i];
         if(qf.queueCount > 0) 
         {
-            if(qf.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if(qf.queueFlags & VK_QUEUE_GRAPHICS_BIT && queue_indices->graphics_index == UINT32_MAX) {
                 queue_indices->graphics_index = i;
             }
             
-            if(qf.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            if(qf.queueFlags & VK_QUEUE_COMPUTE_BIT && queue_indices->compute_index == UINT32_MAX) {
+                queue_indices->compute_index = i;
+            }
+
+            // async compute family, lets the readback pack run next to rendering
+            if((qf.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == VK_QUEUE_COMPUTE_BIT && !found_compute_only) {
                 queue_indices->compute_index = i;
+                found_compute_only = true;
+                printfi("Found compute only index at: %d\n", i);
             }
 
-            if(surface != nullptr) 
+            // dedicated copy engine, lets uploads run next to rendering
+            const VkQueueFlags transfer_only = VK_QUEUE_TRANSFER_BIT;
+            if((qf.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)) == transfer_only &&
+                queue_indices->transfer_index == UINT32_MAX) {
+                queue_indices->transfer_index = i;
+                printfi("Found transfer only index at: %d\n", i);
+            }
+
+            if(surface != nullptr && queue_indices->present_index == UINT32_MAX) 
             {
                 VkBool32 present_support = false;
                 vkGetPhysicalDeviceSurfaceSupportKHR(*device, i, surface->GetSurface(), &present_support);
@@ -196,12 +214,14 @@ bool VulkanPhysicalDevice::hasSupportQueueFamily(VkPhysicalDevice* device, Queue
                 found_surface = true;
             }
         }
+    }
 
-        if(queue_indices->graphics_index < UINT32_MAX && 
-            queue_indices->compute_index < UINT32_MAX && found_surface) return true;
+    if(queue_indices->transfer_index == UINT32_MAX) {
+        queue_indices->transfer_index = queue_indices->graphics_index;
     }
 
-    return false;
+    return queue_indices->graphics_index < UINT32_MAX && 
+        queue_indices->compute_index < UINT32_MAX && found_surface;
 }
 
 bool VulkanPhysicalDevice::hasDeviceSwapChainSupport(VkPhysicalDevice device, const std::vector<const char*> device_extensions)
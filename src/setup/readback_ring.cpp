@@ -0,0 +1,325 @@
+#include "readback_ring.hpp"
+#include "device.hpp"
+#include "pack_pass.hpp"
+
+VulkanReadbackRing::VulkanReadbackRing(
+        VulkanDevice* device, uint32_t width, uint32_t height, VkFormat format, uint32_t slot_count,
+        VulkanPackPass* pack
+    )
+{
+    m_device = device;
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_pack = pack;
+    m_size = (m_pack != nullptr) ? m_pack->GetOutputSize() : static_cast<VkDeviceSize>(width) * height * 4;
+    m_graphics_family = m_device->GetPhysicalDevice()->GetQueueFamily().graphics_index;
+    m_compute_family = m_device->GetPhysicalDevice()->GetQueueFamily().compute_index;
+
+    // the cpu reads every byte back, and uncached memory is very slow to read
+    // on discrete gpus. cached memory that is not coherent is invalidated per job
+    const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const VkPhysicalDeviceMemoryProperties& memory_properties = m_device->GetPhysicalDevice()->GetMemoryProperties();
+    for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+        if((flags & cached) != cached) continue;
+        properties = cached;
+        if(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            properties |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        }
+    }
+
+    printfi("Creating Readback Ring of %d slots...\n", std::max(1u, slot_count));
+    m_slots.resize(std::max(1u, slot_count));
+    for(uint32_t i = 0; i < m_slots.size(); i++)
+    {
+        Slot& slot = m_slots[i];
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if(m_pack != nullptr) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        m_device->CreateBuffer(
+            m_size, usage, properties,
+            &slot.buffer, &slot.memory
+        );
+
+        VkCommandBufferAllocateInfo alloc_info = init::command_buffer_allocate_info(
+            m_device->GetGraphicsCommandPool(), 1
+        );
+        ErrorCheck(vkAllocateCommandBuffers(
+            m_device->GetDevice(), &alloc_info, &slot.command
+        ), "Allocate Readback Command Buffer");
+
+        VkFenceCreateInfo fence_info = init::fence_info();
+        ErrorCheck(vkCreateFence(
+            m_device->GetDevice(), &fence_info, nullptr, &slot.fence
+        ), "Create Readback Fence");
+
+        if(m_pack != nullptr)
+        {
+            VkCommandBufferAllocateInfo pack_alloc_info = init::command_buffer_allocate_info(
+                m_device->GetComputeCommandPool(), 1
+            );
+            ErrorCheck(vkAllocateCommandBuffers(
+                m_device->GetDevice(), &pack_alloc_info, &slot.pack_command
+            ), "Allocate Pack Command Buffer");
+
+            VkSemaphoreCreateInfo semaphore_info = {};
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            ErrorCheck(vkCreateSemaphore(
+                m_device->GetDevice(), &semaphore_info, nullptr, &slot.drawn
+            ), "Create Readback Draw Semaphore");
+            ErrorCheck(vkCreateSemaphore(
+                m_device->GetDevice(), &semaphore_info, nullptr, &slot.packed
+            ), "Create Readback Pack Semaphore");
+
+            slot.pack_set = m_pack->CreateDescriptorSet(slot.buffer);
+        }
+
+        m_free.push_back(static_cast<uint32_t>(m_slots.size()) - 1 - i);
+    }
+}
+
+VulkanReadbackRing::~VulkanReadbackRing()
+{
+    WaitIdle();
+
+    printfi("-- Destroying Readback Ring...\n");
+    for(auto& slot : m_slots)
+    {
+        vkFreeCommandBuffers(m_device->GetDevice(), m_device->GetGraphicsCommandPool(), 1, &slot.command);
+        vkDestroyFence(m_device->GetDevice(), slot.fence, nullptr);
+        if(slot.pack_command != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_device->GetDevice(), m_device->GetComputeCommandPool(), 1, &slot.pack_command);
+            vkDestroySemaphore(m_device->GetDevice(), slot.drawn, nullptr);
+            vkDestroySemaphore(m_device->GetDevice(), slot.packed, nullptr);
+        }
+        m_device->DestroyBuffer(slot.buffer, slot.memory);
+    }
+}
+
+uint32_t VulkanReadbackRing::Begin(VkCommandBuffer* command)
+{
+    if(m_recording != UINT32_MAX) {
+        printff("Readback slot %d is still being recorded\n", m_recording);
+    }
+
+    Poll();
+    if(m_free.empty()) complete(true);
+
+    m_recording = m_free.back();
+    m_free.pop_back();
+
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    ErrorCheck(vkBeginCommandBuffer(
+        m_slots[m_recording].command, &begin_info
+    ), "Begin Readback Command Buffer");
+
+    *command = m_slots[m_recording].command;
+    return m_recording;
+}
+
+void VulkanReadbackRing::RecordCopy(VkImage image)
+{
+    if(m_pack != nullptr) {
+        recordPack(image);
+        return;
+    }
+
+    Slot& slot = m_slots[m_recording];
+
+    // TODO: create buffer image copy in init.hpp
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1
+    };
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {m_width, m_height, 1};
+    vkCmdCopyImageToBuffer(
+        slot.command, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        slot.buffer, 1, &region
+    );
+
+    // the host reads the buffer once the fence signals, and the next job may
+    // only draw over the image after this copy has read it
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        slot.command,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr
+    );
+}
+
+uint64_t VulkanReadbackRing::Submit(ReadbackCallback callback)
+{
+    Slot& slot = m_slots[m_recording];
+    ErrorCheck(vkEndCommandBuffer(slot.command), "End Readback Command Buffer");
+
+    VkSubmitInfo submit_info = init::submit_info(1, &slot.command);
+    if(m_pack == nullptr)
+    {
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetGraphicsQueue(), 1, &submit_info, slot.fence
+        ), "Submit Readback Job");
+    }
+    else
+    {
+        // the draw clears the image the previous pack may still be reading
+        VkPipelineStageFlags draw_wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        if(m_last_packed != VK_NULL_HANDLE) {
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitSemaphores = &m_last_packed;
+            submit_info.pWaitDstStageMask = &draw_wait_stage;
+        }
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &slot.drawn;
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetGraphicsQueue(), 1, &submit_info, VK_NULL_HANDLE
+        ), "Submit Readback Draw");
+
+        VkPipelineStageFlags pack_wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        VkSubmitInfo pack_info = init::submit_info(1, &slot.pack_command);
+        pack_info.waitSemaphoreCount = 1;
+        pack_info.pWaitSemaphores = &slot.drawn;
+        pack_info.pWaitDstStageMask = &pack_wait_stage;
+        pack_info.signalSemaphoreCount = 1;
+        pack_info.pSignalSemaphores = &slot.packed;
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetComputeQueue(), 1, &pack_info, slot.fence
+        ), "Submit Readback Pack");
+        m_last_packed = slot.packed;
+    }
+
+    slot.callback = callback;
+    slot.job = m_next_job++;
+    m_pending.push_back(m_recording);
+    m_recording = UINT32_MAX;
+    return slot.job;
+}
+
+void VulkanReadbackRing::Poll()
+{
+    while(m_pending.size() > 0 && vkGetFenceStatus(m_device->GetDevice(), m_slots[m_pending.front()].fence) == VK_SUCCESS) {
+        complete(false);
+    }
+}
+
+void VulkanReadbackRing::WaitIdle()
+{
+    while(m_pending.size() > 0) complete(true);
+}
+
+uint32_t VulkanReadbackRing::GetSlotCount() { return static_cast<uint32_t>(m_slots.size()); }
+uint32_t VulkanReadbackRing::GetPendingCount() { return static_cast<uint32_t>(m_pending.size()); }
+
+void VulkanReadbackRing::complete(bool wait)
+{
+    uint32_t index = m_pending.front();
+    m_pending.pop_front();
+    Slot& slot = m_slots[index];
+
+    if(wait) {
+        ErrorCheck(vkWaitForFences(
+            m_device->GetDevice(), 1, &slot.fence, VK_TRUE, UINT64_MAX
+        ), "Wait For Readback Fence");
+    }
+    ErrorCheck(vkResetFences(
+        m_device->GetDevice(), 1, &slot.fence
+    ), "Reset Readback Fence");
+
+    if(slot.callback)
+    {
+        m_device->GetAllocator()->Invalidate(slot.memory);
+
+        ReadbackImage image;
+        image.pixels = (const uint8_t*) slot.memory.mapped;
+        image.width = m_width;
+        image.height = m_height;
+        image.row_pitch = (m_pack != nullptr) ? m_pack->GetRowPitch() : static_cast<VkDeviceSize>(m_width) * 4;
+        image.format = (m_pack != nullptr) ? m_pack->GetOutputFormat() : m_format;
+        image.job = slot.job;
+        slot.callback(image);
+        slot.callback = nullptr;
+    }
+
+    m_free.push_back(index);
+}
+
+void VulkanReadbackRing::recordPack(VkImage image)
+{
+    Slot& slot = m_slots[m_recording];
+    const bool separate_family = m_graphics_family != m_compute_family;
+
+    // TODO: create image memory barrier in init.hpp
+    // on the graphics queue, and the release half of the ownership transfer
+    // when compute is its own family. the next draw discards the image, so it is never handed back
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = separate_family ? 0 : VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = separate_family ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = separate_family ? m_compute_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1
+    };
+    vkCmdPipelineBarrier(
+        slot.command,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        separate_family ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier
+    );
+
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    ErrorCheck(vkBeginCommandBuffer(
+        slot.pack_command, &begin_info
+    ), "Begin Pack Command Buffer");
+
+    if(separate_family)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            slot.pack_command,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    }
+
+    m_pack->RecordDispatch(slot.pack_command, slot.pack_set);
+
+    // the host reads the buffer once the fence signals
+    VkMemoryBarrier host_barrier = {};
+    host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    host_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        slot.pack_command,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1, &host_barrier,
+        0, nullptr,
+        0, nullptr
+    );
+
+    ErrorCheck(vkEndCommandBuffer(slot.pack_command), "End Pack Command Buffer");
+}
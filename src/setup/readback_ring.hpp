@@ -0,0 +1,85 @@
+#pragma once
+
+#include "build_order.hpp"
+#include <deque>
+#include <functional>
+#include "memory_allocator.hpp"
+
+class VulkanDevice;
+class VulkanPackPass;
+
+// one finished readback, only valid inside the callback
+struct ReadbackImage {
+    const uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    VkDeviceSize row_pitch; // tightly packed, width * 4 (3 or 1 when packed)
+    VkFormat format;        // R8G8B8 or R8 when packed
+    uint64_t job;
+};
+
+typedef std::function<void(const ReadbackImage&)> ReadbackCallback;
+
+// host visible buffers the color attachment is copied into in the same
+// submission as the draw. jobs complete in submission order through their
+// fences, so the cpu can encode job N while the gpu renders job N+1.
+// with a pack pass the buffers are filled by a compute submission on the compute
+// queue instead, behind a semaphore, and the next draw waits for it to read the image
+class VulkanReadbackRing
+{
+public:
+    // the pack pass has to outlive the ring and allow slot_count descriptor sets
+    VulkanReadbackRing(
+        VulkanDevice*, uint32_t width, uint32_t height, VkFormat, uint32_t slot_count=3,
+        VulkanPackPass* pack=nullptr
+    );
+    ~VulkanReadbackRing();
+
+    // begins the command buffer of a free slot and returns the slot. when every
+    // slot is in flight the oldest job is waited for and completed first
+    uint32_t Begin(VkCommandBuffer*);
+    // image must be in TRANSFER_SRC_OPTIMAL with its color writes made visible.
+    // packed rings move it to SHADER_READ_ONLY_OPTIMAL for the compute queue
+    void RecordCopy(VkImage);
+    // ends and submits the slot on the graphics queue, followed by its pack dispatch
+    uint64_t Submit(ReadbackCallback);
+
+    void Poll(); // completes every finished job without blocking
+    void WaitIdle();
+    uint32_t GetSlotCount();
+    uint32_t GetPendingCount();
+
+private:
+    struct Slot {
+        VkBuffer buffer=VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        VkCommandBuffer command=VK_NULL_HANDLE;
+        VkFence fence=VK_NULL_HANDLE;
+        // packed rings only
+        VkCommandBuffer pack_command=VK_NULL_HANDLE; // compute pool
+        VkDescriptorSet pack_set=VK_NULL_HANDLE;
+        VkSemaphore drawn=VK_NULL_HANDLE;  // draw -> pack
+        VkSemaphore packed=VK_NULL_HANDLE; // pack -> next draw
+        ReadbackCallback callback;
+        uint64_t job=0;
+    };
+
+    VulkanDevice* m_device;
+    uint32_t m_width;
+    uint32_t m_height;
+    VkFormat m_format;
+    VkDeviceSize m_size;
+    VulkanPackPass* m_pack;
+    uint32_t m_graphics_family;
+    uint32_t m_compute_family;
+    VkSemaphore m_last_packed=VK_NULL_HANDLE; // waited for by the next draw
+
+    std::vector<Slot> m_slots;
+    std::deque<uint32_t> m_pending; // in submission order
+    std::vector<uint32_t> m_free;
+    uint32_t m_recording=UINT32_MAX;
+    uint64_t m_next_job=1;
+
+    void complete(bool wait);
+    void recordPack(VkImage);
+};
@@ -0,0 +1,458 @@
+#include "staging_ring.hpp"
+#include "device.hpp"
+
+VulkanStagingRing::VulkanStagingRing(VulkanDevice* device, VkDeviceSize size)
+{
+    m_device = device;
+    m_size = size;
+
+    VkPhysicalDeviceLimits& limits = m_device->GetPhysicalDevice()->GetProperties().limits;
+    m_alignment = std::max<VkDeviceSize>(16, limits.optimalBufferCopyOffsetAlignment);
+
+    m_device->CreateBuffer(
+        m_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &m_buffer, &m_memory
+    );
+    m_mapped = (uint8_t*) m_memory.mapped;
+
+    m_transfer_family = m_device->GetPhysicalDevice()->GetQueueFamily().transfer_index;
+    m_graphics_family = m_device->GetPhysicalDevice()->GetQueueFamily().graphics_index;
+    m_separate_family = m_transfer_family != m_graphics_family;
+    if(m_separate_family) {
+        printfi("Staging uploads run on transfer family %d\n", m_transfer_family);
+    }
+}
+
+VulkanStagingRing::~VulkanStagingRing()
+{
+    WaitIdle();
+
+    printfi("-- Destroying Staging Ring...\n");
+    for(auto& submission : m_free) destroySubmission(submission);
+    m_device->DestroyBuffer(m_buffer, m_memory);
+}
+
+void VulkanStagingRing::UploadBuffer(VkBuffer dst_buffer, const void* data, VkDeviceSize size, VkDeviceSize dst_offset)
+{
+    VkDeviceSize range_offset = dst_offset;
+    VkDeviceSize range_size = size;
+    const uint8_t* src = (const uint8_t*) data;
+    const VkDeviceSize chunk_limit = m_size / 2;
+
+    while(size > 0)
+    {
+        VkDeviceSize chunk = std::min(size, chunk_limit);
+        memcpy(beginCopy(dst_buffer, chunk, dst_offset), src, chunk);
+
+        src += chunk;
+        dst_offset += chunk;
+        size -= chunk;
+    }
+
+    TrackBuffer(dst_buffer, range_offset, range_size);
+}
+
+void VulkanStagingRing::UploadRanges(VkBuffer dst_buffer, const void* data, const UploadRange* ranges, uint32_t count)
+{
+    if(count == 0) return;
+    const uint8_t* src = (const uint8_t*) data;
+
+    VkDeviceSize total = 0;
+    VkDeviceSize range_begin = ranges[0].offset;
+    VkDeviceSize range_end = 0;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        total += ranges[i].size;
+        range_begin = std::min(range_begin, ranges[i].offset);
+        range_end = std::max(range_end, ranges[i].offset + ranges[i].size);
+    }
+
+    // too big to pack at once, every range goes through the chunked path
+    if(total > m_size / 2)
+    {
+        for(uint32_t i = 0; i < count; i++) {
+            UploadBuffer(dst_buffer, src + ranges[i].offset, ranges[i].size, ranges[i].offset);
+        }
+        return;
+    }
+
+    VkDeviceSize offset = reserve(total);
+    std::vector<VkBufferCopy> copy_regions(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        memcpy(m_mapped + offset, src + ranges[i].offset, ranges[i].size);
+        copy_regions[i].srcOffset = offset;
+        copy_regions[i].dstOffset = ranges[i].offset;
+        copy_regions[i].size = ranges[i].size;
+        offset += ranges[i].size;
+    }
+    vkCmdCopyBuffer(GetCommandBuffer(), m_buffer, dst_buffer, count, copy_regions.data());
+
+    TrackBuffer(dst_buffer, range_begin, range_end - range_begin);
+}
+
+uint8_t* VulkanStagingRing::beginCopy(VkBuffer dst_buffer, VkDeviceSize size, VkDeviceSize dst_offset)
+{
+    VkDeviceSize offset = reserve(size);
+
+    VkBufferCopy copy_region = {};
+    copy_region.srcOffset = offset;
+    copy_region.dstOffset = dst_offset;
+    copy_region.size = size;
+    vkCmdCopyBuffer(GetCommandBuffer(), m_buffer, dst_buffer, 1, &copy_region);
+
+    return m_mapped + offset;
+}
+
+void VulkanStagingRing::UploadImage(
+        VkImage image, uint32_t width, uint32_t height, const void* pixels,
+        uint32_t texel_size, VkImageLayout final_layout
+    )
+{
+    PrepareImages(&image, 1);
+    CopyImage(image, width, height, pixels, texel_size, final_layout);
+}
+
+void VulkanStagingRing::PrepareImages(const VkImage* images, uint32_t count)
+{
+    // TODO: create image memory barrier in init.hpp
+    std::vector<VkImageMemoryBarrier> barriers(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        VkImageMemoryBarrier& barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = images[i];
+        barrier.subresourceRange = {
+            VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1
+        };
+    }
+
+    vkCmdPipelineBarrier(
+        GetCommandBuffer(),
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        count, barriers.data()
+    );
+}
+
+void VulkanStagingRing::CopyImage(
+        VkImage image, uint32_t width, uint32_t height, const void* pixels,
+        uint32_t texel_size, VkImageLayout final_layout
+    )
+{
+    const uint8_t* src = (const uint8_t*) pixels;
+    VkDeviceSize row_size = static_cast<VkDeviceSize>(width) * texel_size;
+    if(row_size > m_size) {
+        printff("Image row of %llu bytes does not fit in staging ring\n", (unsigned long long) row_size);
+    }
+    uint32_t rows_per_chunk = static_cast<uint32_t>(std::max<VkDeviceSize>(1, (m_size / 2) / row_size));
+
+    for(uint32_t y = 0; y < height; y += rows_per_chunk)
+    {
+        uint32_t rows = std::min(rows_per_chunk, height - y);
+        VkDeviceSize chunk = rows * row_size;
+        VkDeviceSize offset = reserve(chunk);
+        memcpy(m_mapped + offset, src + y * row_size, chunk);
+
+        // TODO: create buffer image copy in init.hpp
+        VkBufferImageCopy region = {};
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource = {
+            VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1
+        };
+        region.imageOffset = {0, static_cast<int32_t>(y), 0};
+        region.imageExtent = {width, rows, 1};
+
+        vkCmdCopyBufferToImage(
+            GetCommandBuffer(),
+            m_buffer,
+            image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,
+            &region
+        );
+    }
+
+    // handed to the graphics family in final_layout on Flush()
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1
+    };
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcQueueFamilyIndex = m_separate_family ? m_transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = m_separate_family ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    m_image_barriers.push_back(barrier);
+}
+
+UploadTicket VulkanStagingRing::TrackBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    // TODO: create buffer memory barrier in init.hpp
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.srcQueueFamilyIndex = m_separate_family ? m_transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = m_separate_family ? m_graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    m_buffer_barriers.push_back(barrier);
+
+    GetCommandBuffer();
+    return m_current.serial;
+}
+
+VkCommandBuffer VulkanStagingRing::GetCommandBuffer()
+{
+    if(m_recording) return m_current.command;
+
+    if(m_free.size() > 0) {
+        m_current = m_free.back();
+        m_free.pop_back();
+    } else {
+        m_current = Submission();
+        VkCommandBufferAllocateInfo alloc_info = init::command_buffer_allocate_info(
+            m_device->GetTransferCommandPool(), 1
+        );
+        ErrorCheck(vkAllocateCommandBuffers(
+            m_device->GetDevice(), &alloc_info, &m_current.command
+        ), "Allocate Staging Command Buffer");
+
+        VkFenceCreateInfo fence_info = init::fence_info();
+        ErrorCheck(vkCreateFence(
+            m_device->GetDevice(), &fence_info, nullptr, &m_current.fence
+        ), "Create Staging Fence");
+
+        if(m_separate_family)
+        {
+            alloc_info = init::command_buffer_allocate_info(
+                m_device->GetGraphicsCommandPool(), 1
+            );
+            ErrorCheck(vkAllocateCommandBuffers(
+                m_device->GetDevice(), &alloc_info, &m_current.acquire
+            ), "Allocate Staging Acquire Command Buffer");
+
+            VkSemaphoreCreateInfo semaphore_info = {};
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            ErrorCheck(vkCreateSemaphore(
+                m_device->GetDevice(), &semaphore_info, nullptr, &m_current.semaphore
+            ), "Create Staging Semaphore");
+        }
+    }
+    m_current.serial = m_next_serial++;
+
+    VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    ErrorCheck(vkBeginCommandBuffer(
+        m_current.command, &begin_info
+    ), "Begin Staging Command Buffer");
+
+    m_recording = true;
+    return m_current.command;
+}
+
+UploadTicket VulkanStagingRing::Flush()
+{
+    if(!m_recording) return m_next_serial - 1;
+
+    VkSubmitInfo submit_info = init::submit_info(1, &m_current.command);
+    if(!m_separate_family)
+    {
+        // later submissions on the queue may read what was just copied
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(
+            m_current.command,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            static_cast<uint32_t>(m_image_barriers.size()), m_image_barriers.data()
+        );
+        ErrorCheck(vkEndCommandBuffer(m_current.command), "End Staging Command Buffer");
+
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetTransferQueue(), 1, &submit_info, m_current.fence
+        ), "Submit Staging Copies");
+    }
+    else
+    {
+        recordOwnershipBarriers(m_current.command, false);
+        ErrorCheck(vkEndCommandBuffer(m_current.command), "End Staging Command Buffer");
+
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &m_current.semaphore;
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetTransferQueue(), 1, &submit_info, VK_NULL_HANDLE
+        ), "Submit Staging Copies");
+
+        // the graphics queue takes ownership once the copies are done,
+        // anything submitted to it afterwards is ordered behind this
+        VkCommandBufferBeginInfo begin_info = init::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        ErrorCheck(vkBeginCommandBuffer(
+            m_current.acquire, &begin_info
+        ), "Begin Staging Acquire Command Buffer");
+        recordOwnershipBarriers(m_current.acquire, true);
+        ErrorCheck(vkEndCommandBuffer(m_current.acquire), "End Staging Acquire Command Buffer");
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquire_info = init::submit_info(1, &m_current.acquire);
+        acquire_info.waitSemaphoreCount = 1;
+        acquire_info.pWaitSemaphores = &m_current.semaphore;
+        acquire_info.pWaitDstStageMask = &wait_stage;
+        ErrorCheck(vkQueueSubmit(
+            m_device->GetGraphicsQueue(), 1, &acquire_info, m_current.fence
+        ), "Submit Staging Acquire");
+    }
+
+    m_buffer_barriers.clear();
+    m_image_barriers.clear();
+
+    m_current.bytes = m_pending;
+    m_in_flight.push_back(m_current);
+    m_pending = 0;
+    m_recording = false;
+    return m_current.serial;
+}
+
+bool VulkanStagingRing::IsComplete(UploadTicket ticket)
+{
+    while(m_in_flight.size() > 0 && vkGetFenceStatus(m_device->GetDevice(), m_in_flight.front().fence) == VK_SUCCESS) {
+        reclaim(false);
+    }
+    return ticket <= m_completed_serial;
+}
+
+void VulkanStagingRing::Wait(UploadTicket ticket)
+{
+    if(m_recording && ticket >= m_current.serial) Flush();
+    while(m_in_flight.size() > 0 && m_completed_serial < ticket) reclaim(true);
+}
+
+void VulkanStagingRing::WaitIdle()
+{
+    Flush();
+    while(m_in_flight.size() > 0) reclaim(true);
+}
+
+VkDeviceSize VulkanStagingRing::reserve(VkDeviceSize size)
+{
+    if(size > m_size) {
+        printff("Staging upload of %llu bytes is larger than the ring\n", (unsigned long long) size);
+    }
+
+    // hand back whatever the gpu has already finished with
+    while(m_in_flight.size() > 0 && vkGetFenceStatus(m_device->GetDevice(), m_in_flight.front().fence) == VK_SUCCESS) {
+        reclaim(false);
+    }
+
+    VkDeviceSize offset;
+    VkDeviceSize consumed;
+    while(true)
+    {
+        if(m_used == 0) m_head = 0;
+
+        offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+        consumed = offset - m_head + size;
+        if(offset + size > m_size) { // wrap, the tail end of the ring is skipped
+            offset = 0;
+            consumed = m_size - m_head + size;
+        }
+        if(m_used + consumed <= m_size) break;
+
+        if(m_in_flight.size() <= 0) Flush();
+        reclaim(true);
+    }
+
+    m_head = offset + size;
+    m_used += consumed;
+    m_pending += consumed;
+    return offset;
+}
+
+void VulkanStagingRing::reclaim(bool wait)
+{
+    Submission submission = m_in_flight.front();
+    m_in_flight.pop_front();
+
+    if(wait) {
+        ErrorCheck(vkWaitForFences(
+            m_device->GetDevice(), 1, &submission.fence, VK_TRUE, UINT64_MAX
+        ), "Wait For Staging Fence");
+    }
+    ErrorCheck(vkResetFences(
+        m_device->GetDevice(), 1, &submission.fence
+    ), "Reset Staging Fence");
+
+    m_used -= submission.bytes;
+    m_completed_serial = std::max(m_completed_serial, submission.serial);
+    submission.bytes = 0;
+    m_free.push_back(submission);
+}
+
+// release on the transfer queue, acquire on the graphics queue, both sides
+// have to describe the same buffer ranges and layouts
+void VulkanStagingRing::recordOwnershipBarriers(VkCommandBuffer command, bool acquire)
+{
+    std::vector<VkBufferMemoryBarrier> buffer_barriers = m_buffer_barriers;
+    std::vector<VkImageMemoryBarrier> image_barriers = m_image_barriers;
+    for(auto& barrier : buffer_barriers) {
+        if(acquire) barrier.srcAccessMask = 0;
+        else barrier.dstAccessMask = 0;
+    }
+    for(auto& barrier : image_barriers) {
+        if(acquire) barrier.srcAccessMask = 0;
+        else barrier.dstAccessMask = 0;
+    }
+
+    VkPipelineStageFlags src_stage = acquire ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags dst_stage = acquire ?
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT :
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(
+        command,
+        src_stage,
+        dst_stage,
+        0,
+        0, nullptr,
+        static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+        static_cast<uint32_t>(image_barriers.size()), image_barriers.data()
+    );
+}
+
+void VulkanStagingRing::destroySubmission(Submission& submission)
+{
+    vkFreeCommandBuffers(
+        m_device->GetDevice(), m_device->GetTransferCommandPool(),
+        1, &submission.command
+    );
+    if(submission.acquire != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(
+            m_device->GetDevice(), m_device->GetGraphicsCommandPool(),
+            1, &submission.acquire
+        );
+        vkDestroySemaphore(m_device->GetDevice(), submission.semaphore, nullptr);
+    }
+    vkDestroyFence(m_device->GetDevice(), submission.fence, nullptr);
+}
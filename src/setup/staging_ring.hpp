@@ -0,0 +1,114 @@
+#pragma once
+
+#include "build_order.hpp"
+#include <deque>
+#include "memory_allocator.hpp"
+
+class VulkanDevice;
+
+// serial of a Flush(), complete once the copies are visible to the graphics queue
+typedef uint64_t UploadTicket;
+
+// byte range that is at the same offset in the source and the destination buffer
+struct UploadRange {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
+
+// persistently mapped upload buffer used as a ring, regions are handed back
+// once the fence of the submission that read them has signaled.
+// copies run on the transfer queue when the device has a transfer only family,
+// ownership is then released to the graphics family and acquired behind a semaphore
+class VulkanStagingRing
+{
+public:
+    VulkanStagingRing(VulkanDevice*, VkDeviceSize size=32*1024*1024);
+    ~VulkanStagingRing();
+
+    // both record copies into GetCommandBuffer(), uploads larger than half
+    // the ring are split into chunks (and may submit on the way)
+    void UploadBuffer(VkBuffer, const void*, VkDeviceSize, VkDeviceSize dst_offset=0);
+    // partial update of a buffer mirrored by src, the ranges are packed into
+    // the ring and copied with a single vkCmdCopyBuffer where they fit
+    void UploadRanges(VkBuffer, const void* src, const UploadRange*, uint32_t);
+    // zero copy form of UploadBuffer, fill(dst, first, n) is called once per chunk
+    // and writes elements [first, first + n) straight into the mapped ring
+    template<typename T, typename F>
+    void UploadElements(VkBuffer dst_buffer, size_t count, F fill, VkDeviceSize dst_offset=0)
+    {
+        if(count == 0) return;
+        const size_t chunk_limit = std::max<size_t>(1, static_cast<size_t>(m_size / 2) / sizeof(T));
+        for(size_t first = 0; first < count; first += chunk_limit)
+        {
+            size_t n = std::min(chunk_limit, count - first);
+            T* dst = (T*) beginCopy(dst_buffer, n * sizeof(T), dst_offset + first * sizeof(T));
+            fill(dst, first, n);
+        }
+        TrackBuffer(dst_buffer, dst_offset, count * sizeof(T));
+    }
+    // the image content is discarded and left in final_layout for the graphics queue
+    void UploadImage(
+        VkImage, uint32_t, uint32_t, const void*, uint32_t texel_size=4,
+        VkImageLayout final_layout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    );
+    // batched form of UploadImage, one barrier moves every image to
+    // TRANSFER_DST and CopyImage() then fills them one at a time. once the ring
+    // is full the pending copies are submitted and it waits for space like any upload
+    void PrepareImages(const VkImage*, uint32_t);
+    void CopyImage(
+        VkImage, uint32_t, uint32_t, const void*, uint32_t texel_size=4,
+        VkImageLayout final_layout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    );
+
+    // transfer command buffer currently being recorded, can change after an upload
+    VkCommandBuffer GetCommandBuffer();
+    // hands a range written through GetCommandBuffer() over to the graphics queue
+    UploadTicket TrackBuffer(VkBuffer, VkDeviceSize offset, VkDeviceSize size);
+    UploadTicket Flush(); // submits recorded copies without waiting
+    bool IsComplete(UploadTicket);
+    void Wait(UploadTicket);
+    void WaitIdle();
+
+private:
+    struct Submission {
+        VkCommandBuffer command=VK_NULL_HANDLE; // transfer pool
+        VkCommandBuffer acquire=VK_NULL_HANDLE; // graphics pool, separate families only
+        VkSemaphore semaphore=VK_NULL_HANDLE;   // separate families only
+        VkFence fence=VK_NULL_HANDLE;
+        VkDeviceSize bytes=0; // ring bytes released once the fence signals
+        UploadTicket serial=0;
+    };
+
+    VulkanDevice* m_device;
+    VkBuffer m_buffer=VK_NULL_HANDLE;
+    MemoryAllocation m_memory;
+    uint8_t* m_mapped=nullptr;
+    VkDeviceSize m_size;
+    VkDeviceSize m_alignment;
+
+    uint32_t m_transfer_family;
+    uint32_t m_graphics_family;
+    bool m_separate_family;
+
+    VkDeviceSize m_head=0;
+    VkDeviceSize m_used=0;    // bytes pending or in flight
+    VkDeviceSize m_pending=0; // bytes written since the last Flush()
+
+    bool m_recording=false;
+    Submission m_current;
+    std::deque<Submission> m_in_flight;
+    std::vector<Submission> m_free;
+    UploadTicket m_next_serial=1;
+    UploadTicket m_completed_serial=0;
+
+    // recorded at the end of the current submission
+    std::vector<VkBufferMemoryBarrier> m_buffer_barriers;
+    std::vector<VkImageMemoryBarrier> m_image_barriers;
+
+    VkDeviceSize reserve(VkDeviceSize);
+    // reserves size bytes and records their copy, the caller fills them before the next reserve
+    uint8_t* beginCopy(VkBuffer, VkDeviceSize size, VkDeviceSize dst_offset);
+    void reclaim(bool wait);
+    void recordOwnershipBarriers(VkCommandBuffer, bool acquire);
+    void destroySubmission(Submission&);
+};
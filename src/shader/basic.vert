@@ -5,11 +5,15 @@ layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 // layout(location = 2) in vec2 inTex;
 
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+} pc;
+
 layout(location = 0) out vec3 fragColor;
 // layout(location = 1) out vec2 fragTex;
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
+    gl_Position = pc.projection * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
     // fragTex = inTex;
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// PackedVertex, see vertex_buffer.hpp
+layout(location = 0) in ivec2 inPosition; // 14.2 fixed point pixels
+layout(location = 1) in vec4 inColor;
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = pc.projection * vec4(vec2(inPosition) * 0.25, 0.0, 1.0);
+    fragColor = inColor.rgb;
+}
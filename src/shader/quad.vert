@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inCorner; // unit quad
+
+// per instance
+layout(location = 1) in vec2 inPosition;
+layout(location = 2) in vec3 inShape; // length, thickness, angle
+layout(location = 3) in vec4 inColor;
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    vec2 local = inCorner * inShape.xy;
+    float c = cos(inShape.z);
+    float s = sin(inShape.z);
+    vec2 world = inPosition + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+    gl_Position = pc.projection * vec4(world, 0.0, 1.0);
+    fragColor = inColor.rgb;
+}
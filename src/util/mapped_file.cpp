@@ -0,0 +1,100 @@
+#include "mapped_file.hpp"
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+MappedFile::~MappedFile()
+{
+    if(m_fd >= 0) {
+        printfw("Mapped file %s was not closed, discarding it\n", m_path.c_str());
+        Discard();
+    }
+}
+
+bool MappedFile::Create(const std::string& path, size_t size)
+{
+    if(m_fd >= 0) Discard();
+
+    // unique per process and call, so threads saving the same path do not collide
+    static std::atomic<uint32_t> serial(0);
+    m_path = path;
+    m_temp_path = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(serial++);
+    m_fd = open(m_temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(m_fd < 0) {
+        printfe("Failed to open %s for writing: %s\n", m_temp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // a zero sized mapping is not allowed, map at least a byte. the blocks are
+    // reserved now, a sparse file would fault with SIGBUS once the disk is full
+    size_t map_size = std::max<size_t>(size, 1);
+    int res = posix_fallocate(m_fd, 0, static_cast<off_t>(map_size));
+    if(res != 0) {
+        printfe("Failed to allocate %zu bytes for %s: %s\n", map_size, path.c_str(), strerror(res));
+        release();
+        return false;
+    }
+
+    void* data = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if(data == MAP_FAILED) {
+        printfe("Failed to map %s: %s\n", m_temp_path.c_str(), strerror(errno));
+        release();
+        return false;
+    }
+    // written front to back once
+    madvise(data, map_size, MADV_SEQUENTIAL);
+
+    m_data = (uint8_t*) data;
+    m_size = map_size;
+    return true;
+}
+
+bool MappedFile::Close(size_t size)
+{
+    if(m_fd < 0) return false;
+
+    bool success = true;
+    munmap(m_data, m_size);
+    m_data = nullptr;
+    if(ftruncate(m_fd, static_cast<off_t>(std::min(size, m_size))) != 0) {
+        printfe("Failed to truncate %s: %s\n", m_temp_path.c_str(), strerror(errno));
+        success = false;
+    }
+    if(close(m_fd) != 0) {
+        printfe("Failed to close %s: %s\n", m_temp_path.c_str(), strerror(errno));
+        success = false;
+    }
+    m_fd = -1;
+
+    if(success && rename(m_temp_path.c_str(), m_path.c_str()) != 0) {
+        printfe("Failed to replace %s: %s\n", m_path.c_str(), strerror(errno));
+        success = false;
+    }
+    if(!success) unlink(m_temp_path.c_str());
+
+    m_size = 0;
+    return success;
+}
+
+void MappedFile::Discard()
+{
+    if(m_fd < 0) return;
+    release();
+}
+
+void MappedFile::release()
+{
+    if(m_data != nullptr) munmap(m_data, m_size);
+    close(m_fd);
+    unlink(m_temp_path.c_str());
+    m_fd = -1;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+uint8_t* MappedFile::GetData() { return m_data; }
+size_t MappedFile::GetSize() { return m_size; }
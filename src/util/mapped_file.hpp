@@ -0,0 +1,38 @@
+#pragma once
+
+#include "build_order.hpp"
+
+// output file mapped into memory, sized up front and written through GetData().
+// the data goes to a temporary file next to path whose blocks are allocated by
+// Create(), so a full disk is an error there instead of a SIGBUS on a store.
+// Close() cuts it to the bytes actually written and renames it over path, readers
+// of path only ever see the old or the new content
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // maps size bytes of a new temporary file, path is left untouched
+    bool Create(const std::string& path, size_t size);
+    // unmaps, truncates to size (which must not exceed the mapped size) and
+    // replaces path with the result
+    bool Close(size_t size);
+    // unmaps and removes the temporary file, path is left untouched
+    void Discard();
+
+    uint8_t* GetData();
+    size_t GetSize();
+
+private:
+    int m_fd=-1;
+    uint8_t* m_data=nullptr;
+    size_t m_size=0;
+    std::string m_path;
+    std::string m_temp_path;
+
+    void release();
+};
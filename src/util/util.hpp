@@ -27,4 +27,28 @@ static std::vector<char> read_shader(const std::string& path)
     file.close();
 
     return buffer;
+}
+
+// unlike read_shader, a missing file is not fatal
+static bool read_binary(const std::string& path, std::vector<char>& buffer)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary | std::ios::in);
+    if(!file.is_open()) return false;
+
+    size_t file_size = (size_t) file.tellg();
+    buffer.resize(file_size);
+    file.seekg(0, std::ios::beg);
+    file.read(buffer.data(), file_size);
+    file.close();
+    return file_size > 0;
+}
+
+static bool write_binary(const std::string& path, const char* data, size_t size)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) return false;
+
+    file.write(data, size);
+    file.close();
+    return !file.fail();
 }
\ No newline at end of file